@@ -1,6 +1,9 @@
 #include <thread>
+#include <iostream>
 #include "ten/thread_guard.hh"
 #include "ten/task/rendez.hh"
+#include "ten/channel.hh"
+#include "ten/bounded_channel.hh"
 #include "ten/logging.hh"
 
 using namespace ten;
@@ -46,11 +49,62 @@ void qutex_task_spawn() {
     CHECK(st->x == 20*1000);
 }
 
+// every message crosses threads, so each send is a cross-thread wakeup
+void channel_ping_pong() {
+    taskname("channel_ping_pong");
+    using namespace std::chrono;
+    const int rounds = 100000;
+    channel<int> ping;
+    channel<int> pong;
+    auto start = steady_clock::now();
+    thread_guard ponger{task::spawn_thread([=]() mutable {
+        taskname("ponger");
+        for (int i=0; i<rounds; ++i) {
+            pong.send(ping.recv());
+        }
+    })};
+    for (int i=0; i<rounds; ++i) {
+        ping.send(std::move(i));
+        CHECK(pong.recv() == i);
+    }
+    auto usec = duration_cast<microseconds>(steady_clock::now() - start).count();
+    std::cout << rounds << " cross-thread round trips in " << usec / 1000 << "ms, "
+        << (usec * 1000 / rounds) << "ns each\n";
+}
+
+// one thread streams to another through a 64 slot buffer
+template <typename Chan>
+void channel_stream(const char *name, Chan ch) {
+    taskname("channel_stream");
+    using namespace std::chrono;
+    const int count = 1000000;
+    auto start = steady_clock::now();
+    thread_guard producer{task::spawn_thread([=]() mutable {
+        taskname("producer");
+        for (int i=0; i<count; ++i) {
+            ch.send(std::move(i));
+        }
+    })};
+    long sum = 0;
+    for (int i=0; i<count; ++i) {
+        sum += ch.recv();
+    }
+    CHECK(sum == long(count) * (count - 1) / 2);
+    auto usec = duration_cast<microseconds>(steady_clock::now() - start).count();
+    std::cout << name << ": " << count << " cross-thread sends in " << usec / 1000 << "ms, "
+        << (usec * 1000 / count) << "ns each\n";
+}
+
 int main() {
     return task::main([] {
         for (int i=0; i<10; ++i) {
             task::spawn(qutex_task_spawn);
         }
+        task::spawn(channel_ping_pong);
+        task::spawn([] {
+            channel_stream("channel", channel<int>{64});
+            channel_stream("bounded_channel", bounded_channel<int, 64>{});
+        });
     });
 }
 
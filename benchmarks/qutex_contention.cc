@@ -0,0 +1,53 @@
+#include "ten/task.hh"
+#include "ten/task/qutex.hh"
+#include "ten/thread_guard.hh"
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <boost/lexical_cast.hpp>
+
+using namespace ten;
+using namespace std::chrono;
+
+// qutex_contention [iterations] [max_threads]
+// one task per thread locks and unlocks a shared qutex in a loop.
+// runs with 1 thread (uncontended), 2 threads and max_threads
+// (default cpu count) and prints ns per lock/unlock pair.
+
+static void run(size_t nthreads, size_t iterations) {
+    qutex q;
+    uint64_t counter = 0;
+    std::vector<thread_guard> threads;
+    const auto start = steady_clock::now();
+    for (size_t i=0; i<nthreads; ++i) {
+        threads.emplace_back(task::spawn_thread([&] {
+            for (size_t n=0; n<iterations; ++n) {
+                std::lock_guard<qutex> lk{q};
+                ++counter;
+            }
+        }));
+    }
+    threads.clear();
+    const auto ns = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    const uint64_t total = nthreads * iterations;
+    CHECK(counter == total);
+    std::cout << nthreads << " threads: " << (double)ns / total << " ns per lock/unlock\n";
+}
+
+int main(int argc, char *argv[]) {
+    return task::main([&] {
+        size_t iterations = 1000000;
+        size_t max_threads = kernel::cpu_count();
+        if (argc >= 2) {
+            iterations = boost::lexical_cast<size_t>(argv[1]);
+        }
+        if (argc >= 3) {
+            max_threads = boost::lexical_cast<size_t>(argv[2]);
+        }
+        run(1, iterations);
+        run(2, iterations);
+        if (max_threads > 2) {
+            run(max_threads, iterations);
+        }
+    });
+}
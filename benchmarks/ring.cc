@@ -1,13 +1,22 @@
 #include "ten/task.hh"
 #include "ten/channel.hh"
+#include "ten/bounded_channel.hh"
 #include <iostream>
 #include <boost/lexical_cast.hpp>
 #include <chrono>
+#include <vector>
+#include <algorithm>
 
 using namespace ten;
 using namespace std::chrono;
 
-void one_ring(channel<int> chin, channel<int> chout, int m, int n) {
+// ring [tasks] [messages] [channel|bounded|batch] [batch_size]
+// passes a token around a ring of tasks over channel<int>
+// or bounded_channel<int>. batch passes batch_size messages
+// (default 16) at a time with send_n and recv_up_to instead
+
+template <typename Chan>
+void one_ring(Chan chin, Chan chout, int m, int n) {
     auto start = high_resolution_clock::now();
     std::cout << "sending " << m << " messages in ring of " << n << " tasks\n";
     chout.send(0);
@@ -25,7 +34,8 @@ void one_ring(channel<int> chin, channel<int> chout, int m, int n) {
     std::cout << (n*m) << " messages in " << duration_cast<milliseconds>(stop - start).count() << "ms\n";
 }
 
-void ring(channel<int> chin, channel<int> chout) {
+template <typename Chan>
+void ring(Chan chin, Chan chout) {
     try {
         for (;;) {
             int n = chin.recv();
@@ -36,28 +46,93 @@ void ring(channel<int> chin, channel<int> chout) {
     }
 }
 
+template <typename Chan>
+void run(int n, int m) {
+    Chan chin;
+    Chan chfirst = chin;
+    for (int i=0; i<n; ++i) {
+        Chan chout;
+        task::spawn([=] {
+            ring(chin, chout);
+        });
+        chin = chout;
+    }
+    task::spawn([=] {
+        one_ring(chin, chfirst, m, n);
+    });
+}
+
+void batch_ring(channel<int> chin, channel<int> chout, size_t batch) {
+    std::vector<int> items;
+    items.reserve(batch);
+    try {
+        for (;;) {
+            items.clear();
+            chin.recv_up_to(std::back_inserter(items), batch);
+            chout.send_n(items);
+        }
+    } catch (channel_closed_error &e) {
+        chout.close();
+    }
+}
+
+void run_batch(int n, int m, size_t batch) {
+    // big enough that a whole batch fits without waiting
+    const size_t capacity = std::max<size_t>(batch, 2);
+    channel<int> chin{capacity};
+    channel<int> chfirst = chin;
+    for (int i=0; i<n; ++i) {
+        channel<int> chout{capacity};
+        task::spawn([=] {
+            batch_ring(chin, chout, batch);
+        });
+        chin = chout;
+    }
+    task::spawn([=]() mutable {
+        auto start = high_resolution_clock::now();
+        std::cout << "sending " << m << " messages in batches of " << batch
+            << " in ring of " << n << " tasks\n";
+        std::vector<int> items;
+        for (int sent = 0; sent < m; ) {
+            const size_t k = std::min<size_t>(batch, m - sent);
+            items.assign(k, sent);
+            chfirst.send_n(items);
+            items.clear();
+            for (size_t got = 0; got < k; ) {
+                got += chin.recv_up_to(std::back_inserter(items), k - got);
+            }
+            sent += k;
+        }
+        chfirst.close();
+        auto stop = high_resolution_clock::now();
+        std::cout << (n*m) << " messages in " << duration_cast<milliseconds>(stop - start).count() << "ms\n";
+    });
+}
+
 int main(int argc, char *argv[]) {
     return task::main([&] {
-        channel<int> chin;
-        channel<int> chfirst = chin;
         int n = 10;
         int m = 1000;
+        std::string kind = "channel";
         if (argc >= 2) {
             n = boost::lexical_cast<int>(argv[1]);
         }
         if (argc >= 3) {
             m = boost::lexical_cast<int>(argv[2]);
         }
-        for (int i=0; i<n; ++i) {
-            channel<int> chout;
-            task::spawn([=] {
-                ring(chin, chout);
-            });
-            chin = chout;
+        size_t batch = 16;
+        if (argc >= 4) {
+            kind = argv[3];
+        }
+        if (argc >= 5) {
+            batch = boost::lexical_cast<size_t>(argv[4]);
+        }
+        if (kind == "batch") {
+            run_batch(n, m, batch);
+        } else if (kind == "bounded") {
+            run<bounded_channel<int>>(n, m);
+        } else {
+            run<channel<int>>(n, m);
         }
-        task::spawn([=] {
-            one_ring(chin, chfirst, m, n);
-        });
     });
 }
-
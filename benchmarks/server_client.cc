@@ -2,71 +2,148 @@
 #include "ten/channel.hh"
 #include <iostream>
 #include <unordered_map>
+#include <algorithm>
+#include <boost/lexical_cast.hpp>
+
+// server_client [busy_poll_us] [connections] [oneshot|edge]
+// connections (default 1000) from another thread, each does a few one byte
+// round trips to an echo server. prints connect results, round
+// trip latency percentiles and the epoll syscalls made by each thread.
+// busy_poll_us turns on kernel::set_busy_poll in both threads and
+// SO_BUSY_POLL on the sockets. edge registers the connected sockets
+// once with netsock::set_edge_triggered instead of re-arming each wait.
 
 using namespace ten;
+using namespace std::chrono;
+
+static const int round_trips = 10;
+
+struct result {
+    int error;
+    std::vector<nanoseconds> rtts;
+};
+
+static void busy_poll_socket(netsock &s, microseconds busy) {
+    if (busy.count() == 0) return;
+    try {
+        s.set_busy_poll(busy);
+    } catch (errorx &e) {
+        // needs CAP_NET_ADMIN above net.core.busy_read
+    }
+}
 
-static void connecter(const address &addr, channel<int> ch) {
+static void connecter(const address &addr, channel<result> ch, microseconds busy, bool edge) {
+    result r{0, {}};
     try {
         netsock s(AF_INET, SOCK_STREAM);
-        if (s.connect(addr, std::chrono::milliseconds{100}) == 0) {
-            ch.send(0);
+        busy_poll_socket(s, busy);
+        if (s.connect(addr, milliseconds{100}) == 0) {
+            if (edge) s.set_edge_triggered();
+            char c = 'x';
+            for (int i=0; i<round_trips; ++i) {
+                auto start = steady_clock::now();
+                if (s.send(&c, 1) != 1 || s.recv(&c, 1) != 1) break;
+                r.rtts.push_back(steady_clock::now() - start);
+            }
         } else {
-            ch.send(std::move(errno));
+            r.error = errno;
         }
     } catch (errorx &e) {
-        ch.send(std::move(errno));
+        r.error = errno;
     }
+    ch.send(std::move(r));
 }
 
-static void handler(int fd) {
+static void handler(int fd, microseconds busy, bool edge) {
     netsock s(fd);
+    busy_poll_socket(s, busy);
+    if (edge) s.set_edge_triggered();
     char buf[32];
     for (;;) {
         ssize_t nr = s.recv(buf, sizeof(buf));
         if (nr <= 0) break;
+        if (s.send(buf, nr) != nr) break;
     }
 }
 
-static void listener(netsock &sock) {
+static void listener(netsock &sock, microseconds busy, bool edge) {
     address addr;
     for (;;) {
         int fd = sock.accept(addr);
         if (fd != -1) {
             task::spawn([=] {
-                handler(fd);
+                handler(fd, busy, edge);
             });
         }
     }
 }
 
-static void connecter_spawner(const address &addr, const channel<int> &ch) {
-    for (int i=0; i<1000; ++i) {
-        task::spawn([=] {
-            connecter(addr, ch);
-        });
+static void connecter_spawner(const address &addr, const channel<result> &ch,
+        microseconds busy, unsigned nconns, bool edge, kernel::io_stats &stats) {
+    kernel::set_busy_poll(busy);
+    std::vector<task> conns;
+    for (unsigned i=0; i<nconns; ++i) {
+        conns.emplace_back(task::spawn([=] {
+            connecter(addr, ch, busy, edge);
+        }));
     }
+    for (auto &t : conns) {
+        t.join();
+    }
+    stats = kernel::thread_io_stats();
+}
+
+static void print_io_stats(const char *name, const kernel::io_stats &st) {
+    std::cout << name << " epoll_ctl " << st.ctl
+        << " epoll_wait " << st.wait
+        << " edge ready " << st.edge_ready << "\n";
+}
+
+static void print_latency(std::vector<nanoseconds> &rtts) {
+    if (rtts.empty()) return;
+    std::sort(rtts.begin(), rtts.end());
+    auto pct = [&](double p) {
+        return duration_cast<microseconds>(rtts[(size_t)(p * (rtts.size() - 1))]).count();
+    };
+    std::cout << rtts.size() << " round trips: p50 " << pct(0.5)
+        << "us p99 " << pct(0.99)
+        << "us p99.9 " << pct(0.999)
+        << "us max " << pct(1.0) << "us\n";
 }
 
 int main(int argc, char *argv[]) {
-    return task::main([] {
-        channel<int> ch(1000);
+    return task::main([&] {
+        microseconds busy{0};
+        unsigned nconns = 1000;
+        if (argc >= 2) {
+            busy = microseconds{boost::lexical_cast<int>(argv[1])};
+        }
+        if (argc >= 3) {
+            nconns = boost::lexical_cast<unsigned>(argv[2]);
+        }
+        const bool edge = argc >= 4 && std::string(argv[3]) == "edge";
+        kernel::set_busy_poll(busy);
+        channel<result> ch(nconns);
         address addr{AF_INET};
         netsock s(AF_INET, SOCK_STREAM | SOCK_NONBLOCK);
         s.bind(addr);
         s.listen();
         s.getsockname(addr);
         task listen_task = task::spawn([&] {
-            listener(s);
+            listener(s, busy, edge);
         });
         this_task::yield(); // let listener get setup
-        std::thread connecter_thread = task::spawn_thread([=] {
-            connecter_spawner(addr, ch);
+        kernel::io_stats client_stats;
+        std::thread connecter_thread = task::spawn_thread([=, &client_stats] {
+            connecter_spawner(addr, ch, busy, nconns, edge, client_stats);
         });
 
         std::unordered_map<int, unsigned int> results;
-        for (unsigned i=0; i<1000; ++i) {
-            int result = ch.recv();
-            results[result] += 1;
+        std::vector<nanoseconds> rtts;
+        for (unsigned i=0; i<nconns; ++i) {
+            result r = ch.recv();
+            results[r.error] += 1;
+            rtts.insert(rtts.end(), r.rtts.begin(), r.rtts.end());
         }
         for (auto i=results.begin(); i!=results.end(); ++i) {
             if (i->first == 0) {
@@ -75,8 +152,11 @@ int main(int argc, char *argv[]) {
                 std::cout << strerror(i->first) << ": " << i->second << "\n";
             }
         }
+        print_latency(rtts);
+        connecter_thread.join();
+        print_io_stats("server", kernel::thread_io_stats());
+        print_io_stats("client", client_stats);
         std::cout << std::endl;
         listen_task.cancel();
-        connecter_thread.join();
     });
 }
@@ -0,0 +1,72 @@
+#include "ten/task.hh"
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <boost/lexical_cast.hpp>
+
+using namespace ten;
+using namespace std::chrono;
+
+// spawn_rate [threads] [seconds]
+// each thread spawns short tasks in a loop, the way an accept loop
+// spawns a task per connection, and keeps at most a few in flight.
+// prints tasks/sec for each thread and the total.
+
+static const size_t in_flight = 64;
+
+static void spawner(milliseconds run_for, std::atomic<uint64_t> &total, uint64_t &mine) {
+    size_t live = 0;
+    uint64_t done = 0;
+    const auto end = steady_clock::now() + run_for;
+    while (steady_clock::now() < end) {
+        for (int i=0; i<1000; ++i) {
+            while (live >= in_flight) {
+                this_task::yield();
+            }
+            ++live;
+            task::spawn([&] {
+                --live;
+                ++done;
+            });
+        }
+    }
+    while (live) {
+        this_task::yield();
+    }
+    mine = done;
+    total += done;
+}
+
+int main(int argc, char *argv[]) {
+    return task::main([&] {
+        size_t nthreads = 1;
+        double seconds = 2;
+        if (argc >= 2) {
+            nthreads = boost::lexical_cast<size_t>(argv[1]);
+        }
+        if (argc >= 3) {
+            seconds = boost::lexical_cast<double>(argv[2]);
+        }
+        const milliseconds run_for{(int64_t)(seconds * 1000)};
+        std::atomic<uint64_t> total{0};
+        std::vector<uint64_t> per_thread(nthreads);
+        std::vector<std::thread> threads;
+        const auto start = steady_clock::now();
+        for (size_t i=1; i<nthreads; ++i) {
+            threads.emplace_back(task::spawn_thread([&, i] {
+                spawner(run_for, total, per_thread[i]);
+            }));
+        }
+        spawner(run_for, total, per_thread[0]);
+        for (auto &t : threads) {
+            t.join();
+        }
+        const double secs = duration<double>(steady_clock::now() - start).count();
+        for (size_t i=0; i<nthreads; ++i) {
+            std::cout << "thread " << i << ": " << (uint64_t)(per_thread[i] / secs) << " tasks/sec\n";
+        }
+        std::cout << "total: " << (uint64_t)(total / secs) << " tasks/sec, "
+            << (uint64_t)(total / secs / nthreads) << " per thread\n";
+    });
+}
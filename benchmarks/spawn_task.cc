@@ -1,17 +1,60 @@
 #include "ten/task.hh"
 #include <iostream>
+#include <string>
+#include <chrono>
+#include <boost/lexical_cast.hpp>
 
 using namespace ten;
+using namespace std::chrono;
 
-int main() {
-    return task::main([] {
-        intmax_t count=0;
-        try {
-            for (;;) {
-                task::spawn([] {});
-                ++count;
-            }
-        } catch (std::bad_alloc &) {}
-        std::cout << count << "\n";
+// spawn_task [n]   time spawning n empty tasks and running them to exit
+// spawn_task max   spawn until allocation fails and print the count
+
+static void spawn_until_bad_alloc() {
+    intmax_t count=0;
+    try {
+        for (;;) {
+            task::spawn([] {});
+            ++count;
+        }
+    } catch (std::bad_alloc &) {}
+    std::cout << count << "\n";
+}
+
+static void spawn_and_exit(size_t n) {
+    size_t exited = 0;
+    // warm the stack cache so both runs measure the steady state
+    for (int round=0; round<2; ++round) {
+        exited = 0;
+        auto start = steady_clock::now();
+        for (size_t i=0; i<n; ++i) {
+            task::spawn([&exited] { ++exited; });
+        }
+        auto spawned = steady_clock::now();
+        while (exited < n) {
+            this_task::yield();
+        }
+        // let the last task be collected
+        this_task::yield();
+        auto done = steady_clock::now();
+        if (round == 0) continue;
+        auto spawn_ns = duration_cast<nanoseconds>(spawned - start).count();
+        auto exit_ns = duration_cast<nanoseconds>(done - spawned).count();
+        std::cout << n << " tasks: spawn " << spawn_ns / n << "ns, run+exit "
+            << exit_ns / n << "ns per task\n";
+    }
+}
+
+int main(int argc, char *argv[]) {
+    return task::main([&] {
+        if (argc >= 2 && std::string{argv[1]} == "max") {
+            spawn_until_bad_alloc();
+            return;
+        }
+        size_t n = 10000;
+        if (argc >= 2) {
+            n = boost::lexical_cast<size_t>(argv[1]);
+        }
+        spawn_and_exit(n);
     });
 }
@@ -0,0 +1,61 @@
+#include "ten/task.hh"
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <boost/lexical_cast.hpp>
+
+// many long timeouts that are constantly canceled and re-armed,
+// like recv timeouts on a busy server with lots of connections.
+
+using namespace ten;
+using namespace std::chrono;
+
+static uint64_t rearms = 0;
+static bool done = false;
+
+static std::unique_ptr<deadline> arm() {
+    // far enough out that none of them fire
+    return std::unique_ptr<deadline>{new deadline{milliseconds{60000 + random() % 60000}}};
+}
+
+static void churn(size_t ntimers) {
+    std::vector<std::unique_ptr<deadline>> timers;
+    for (size_t i=0; i<ntimers; ++i) {
+        timers.emplace_back(arm());
+    }
+    this_task::yield();
+    while (!done) {
+        for (int i=0; i<100; ++i) {
+            // cancel one and arm a new one
+            timers[random() % ntimers] = arm();
+            ++rearms;
+        }
+        this_task::yield();
+    }
+}
+
+int main(int argc, char *argv[]) {
+    return task::main([&] {
+        size_t ntimers = 100000;
+        size_t ntasks = 100;
+        if (argc >= 2) {
+            ntimers = boost::lexical_cast<size_t>(argv[1]);
+        }
+        if (argc >= 3) {
+            ntasks = boost::lexical_cast<size_t>(argv[2]);
+        }
+        std::cout << ntimers << " live timers in " << ntasks << " tasks\n";
+        for (size_t i=0; i<ntasks; ++i) {
+            task::spawn([=] {
+                churn(ntimers / ntasks);
+            });
+        }
+        this_task::yield();
+        for (int i=0; i<5; ++i) {
+            this_task::sleep_for(seconds{1});
+            std::cout << "re-arms/sec: " << rearms << "\n";
+            rearms = 0;
+        }
+        done = true;
+    });
+}
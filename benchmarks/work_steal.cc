@@ -0,0 +1,96 @@
+#include "ten/task.hh"
+#include "ten/task/proc_group.hh"
+#include "ten/thread_guard.hh"
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <boost/lexical_cast.hpp>
+#include <chrono>
+
+// skewed load: one thread spawns nearly all the work.
+// pinned runs it with a scheduler per thread, tasks never move.
+// group runs it in a proc_group where idle threads steal.
+
+using namespace ten;
+using namespace std::chrono;
+
+static std::atomic<size_t> done{0};
+
+static void burn(microseconds us) {
+    // a few yields so tasks interleave like real work
+    for (int i=0; i<4; ++i) {
+        auto end = steady_clock::now() + us / 4;
+        while (steady_clock::now() < end) {}
+        this_task::yield();
+    }
+    ++done;
+}
+
+// thread 0 gets 90% of the tasks, the rest share 10%
+static size_t share(size_t thread, size_t nthreads, size_t ntasks) {
+    if (nthreads == 1) return ntasks;
+    size_t cold = ntasks / 10 / (nthreads - 1);
+    return thread == 0 ? ntasks - cold * (nthreads - 1) : cold;
+}
+
+static void report(const char *name, steady_clock::time_point start, size_t ntasks) {
+    auto ms = duration_cast<milliseconds>(steady_clock::now() - start).count();
+    std::cout << name << ": " << done << "/" << ntasks << " tasks in " << ms << "ms\n";
+}
+
+static void pinned(size_t nthreads, size_t ntasks, microseconds us) {
+    done = 0;
+    auto start = steady_clock::now();
+    {
+        std::vector<thread_guard> threads;
+        for (size_t i=0; i<nthreads; ++i) {
+            size_t n = share(i, nthreads, ntasks);
+            threads.emplace_back(task::spawn_thread([=] {
+                for (size_t j=0; j<n; ++j) {
+                    task::spawn([=] { burn(us); });
+                }
+            }));
+        }
+    }
+    report("pinned", start, ntasks);
+}
+
+static void group(size_t nthreads, size_t ntasks, microseconds us) {
+    done = 0;
+    auto start = steady_clock::now();
+    {
+        proc_group g{nthreads};
+        for (size_t i=0; i<nthreads; ++i) {
+            size_t n = share(i, nthreads, ntasks);
+            // each producer runs on some group thread and
+            // spawns into that thread's deque
+            g.spawn([=, &g] {
+                for (size_t j=0; j<n; ++j) {
+                    g.spawn([=] { burn(us); });
+                }
+            });
+        }
+    }
+    report("group", start, ntasks);
+}
+
+int main(int argc, char *argv[]) {
+    return task::main([&] {
+        size_t nthreads = kernel::cpu_count();
+        size_t ntasks = 10000;
+        microseconds us{100};
+        if (argc >= 2) {
+            nthreads = boost::lexical_cast<size_t>(argv[1]);
+        }
+        if (argc >= 3) {
+            ntasks = boost::lexical_cast<size_t>(argv[2]);
+        }
+        if (argc >= 4) {
+            us = microseconds{boost::lexical_cast<int>(argv[3])};
+        }
+        std::cout << nthreads << " threads, " << ntasks << " tasks of "
+            << us.count() << "us, 90% spawned by one thread\n";
+        pinned(nthreads, ntasks, us);
+        group(nthreads, ntasks, us);
+    });
+}
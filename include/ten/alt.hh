@@ -0,0 +1,130 @@
+#ifndef LIBTEN_ALT_HH
+#define LIBTEN_ALT_HH
+
+#include "ten/channel.hh"
+#include <vector>
+
+namespace ten {
+
+//! wait for the first of several channel sends and recvs
+//
+//! add cases with recv and send, then wait. the task queues on
+//! every channel's rendez at once and is woken once, by whichever
+//! case becomes ready first, so a fan-in loop needs no helper tasks.
+//! cases stay added, so one alt can wait in a loop.
+//! a send to an unbuffered channel completes when the item is
+//! queued, it does not wait for recv like channel::send.
+//!
+//!     alt a;
+//!     a.recv(requests, req);
+//!     a.recv(shutdown, sig);
+//!     switch (a.wait(milliseconds{100})) {
+//!         case 0: handle(req); break;
+//!         case 1: return;
+//!         case -1: idle(); break;
+//!     }
+class alt {
+public:
+    //! one send or recv, all virtuals are called holding lock()
+    struct case_base {
+        virtual ~case_base() {}
+        virtual qutex &lock() = 0;
+        //! where the task waits for this case
+        virtual rendez &waitq() = 0;
+        //! true if complete would not block
+        virtual bool ready() = 0;
+        //! do the send or recv, false if the channel is closed instead
+        virtual bool complete() = 0;
+    };
+private:
+    template <typename T, typename ContainerT>
+    struct recv_case : case_base {
+        channel<T, ContainerT> ch;
+        T &out;
+
+        recv_case(const channel<T, ContainerT> &ch_, T &out_) : ch(ch_), out(out_) {}
+        qutex &lock() override { return ch._m->qtx; }
+        rendez &waitq() override { return ch._m->not_empty; }
+        bool ready() override { return !ch._m->is_empty() || ch._m->closed; }
+        bool complete() override {
+            if (ch._m->is_empty()) return false;
+            out = ch._m->pop_locked();
+            return true;
+        }
+    };
+
+    template <typename T, typename ContainerT>
+    struct send_case : case_base {
+        channel<T, ContainerT> ch;
+        T value;
+
+        send_case(const channel<T, ContainerT> &ch_, T value_) : ch(ch_), value(std::move(value_)) {}
+        qutex &lock() override { return ch._m->qtx; }
+        rendez &waitq() override { return ch._m->not_full; }
+        bool ready() override { return !ch._m->is_full() || ch._m->closed; }
+        bool complete() override {
+            if (ch._m->closed) return false;
+            T copy(value);
+            ch._m->push_locked(std::move(copy));
+            return true;
+        }
+    };
+
+    std::vector<std::unique_ptr<case_base>> _cases;
+    //! where the next poll starts, so no case starves the others
+    size_t _next = 0;
+    bool _closed = false;
+
+    //! complete the first ready case, or -1
+    int poll();
+    //! complete case i if it is ready
+    bool try_case(size_t i);
+    //! like try_case, but sets busy instead of waiting for the lock
+    bool try_case(size_t i, bool &busy);
+    //! wait until a case completes, or -1 once ms passes
+    int wait_any(optional_timeout ms);
+public:
+    alt() {}
+    alt(const alt &) = delete;
+    alt &operator =(const alt &) = delete;
+
+    //! recv from ch into out, returns the case index
+    template <typename T, typename ContainerT>
+    int recv(const channel<T, ContainerT> &ch, T &out) {
+        _cases.emplace_back(new recv_case<T, ContainerT>(ch, out));
+        return _cases.size() - 1;
+    }
+
+    //! send a copy of value on ch, returns the case index
+    template <typename T, typename ContainerT>
+    int send(const channel<T, ContainerT> &ch, T value) {
+        _cases.emplace_back(new send_case<T, ContainerT>(ch, std::move(value)));
+        return _cases.size() - 1;
+    }
+
+    //! complete one ready case, waiting up to ms for one
+    //! \return the case index, or -1 on timeout
+    int wait(optional_timeout ms = nullopt);
+
+    //! complete one case if any is ready, -1 otherwise
+    int try_wait();
+
+    //! like try_wait, but never waits for a channel's lock.
+    //! busy is set if a case could not be checked because of it
+    int try_wait(bool &busy);
+
+    //! queue w on every case without blocking, for waiters that are
+    //! not tasks, see coro::wait. \return true if w will be claimed,
+    //! false if a case is ready or a lock was busy, try_wait again then
+    bool enqueue(rendez::alt_waiter &w);
+    //! take w off every case it is still queued on
+    void dequeue(rendez::alt_waiter &w);
+
+    //! true if the last completed case found its channel closed
+    //! instead of sending or receiving
+    bool closed() const { return _closed; }
+};
+
+} // end namespace ten
+
+#endif // LIBTEN_ALT_HH
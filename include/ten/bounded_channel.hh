@@ -0,0 +1,172 @@
+#ifndef LIBTEN_BOUNDED_CHANNEL_HH
+#define LIBTEN_BOUNDED_CHANNEL_HH
+
+#include "ten/channel.hh"
+#include "ten/mpmc_bounded_queue.hh"
+
+namespace ten {
+
+//! buffered channel on a lock-free ring of Capacity items
+//
+//! send and recv only touch the qutex and wait lists when the ring
+//! is full or empty, or when the other side has tasks waiting, so
+//! steady state cross-thread pipelines don't serialize on a lock.
+//! Capacity must be a power of two, at least 2, and there is no
+//! synchronous mode. close works like channel: send throws
+//! channel_closed_error, recv returns what is left then throws.
+//! T must be default constructible and move assignable.
+template <typename T, size_t Capacity = 64> class bounded_channel {
+private:
+    struct impl;
+    std::shared_ptr<impl> _m;
+    bool _autoclose;
+public:
+    explicit bounded_channel(bool autoclose=false)
+        : _m(std::make_shared<impl>()), _autoclose(autoclose)
+    {
+    }
+
+    bounded_channel(const bounded_channel &other) : _m(other._m), _autoclose(false) {}
+    bounded_channel &operator = (const bounded_channel &other) {
+        _m = other._m;
+        _autoclose = false;
+        return *this;
+    }
+
+    ~bounded_channel() {
+        if (_autoclose) {
+            close();
+        }
+    }
+
+    //! send data, waiting while the ring is full
+    void send(T &&p) {
+        _m->send(std::move(p));
+    }
+
+    //! send data if there is room, false when the ring is full
+    bool try_send(T &&p) {
+        return _m->try_send(p);
+    }
+
+    //! receive data, waiting while the ring is empty
+    T recv() {
+        return _m->recv();
+    }
+
+    //! receive data if any is ready, false when the ring is empty
+    bool try_recv(T &item) {
+        return _m->try_recv(item);
+    }
+
+    bool is_closed() const {
+        return _m->closed.load();
+    }
+
+    void close() {
+        _m->close();
+    }
+
+private:
+    struct impl {
+        mpmc_bounded_queue<T, Capacity> queue;
+        std::atomic<bool> closed{false};
+        //! tasks waiting or about to wait on the rendez below
+        std::atomic<size_t> recv_waiters{0};
+        std::atomic<size_t> send_waiters{0};
+        qutex qtx;
+        rendez not_empty;
+        rendez not_full;
+
+        impl() {}
+        impl(const impl &) = delete;
+        impl &operator =(const impl &) = delete;
+
+        struct waiting {
+            std::atomic<size_t> &n;
+            explicit waiting(std::atomic<size_t> &n_) : n(n_) {
+                ++n;
+                // pairs with the fence in has_waiters, so either we
+                // see their queue change or they see us waiting
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+            ~waiting() { --n; }
+        };
+
+        static bool has_waiters(const std::atomic<size_t> &n) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            return n.load(std::memory_order_relaxed) != 0;
+        }
+
+        void check_closed() {
+            if (closed.load()) throw channel_closed_error();
+        }
+
+        bool try_send(T &p) {
+            check_closed();
+            if (!queue.enqueue(std::move(p))) return false;
+            if (has_waiters(recv_waiters)) {
+                // waiters join the rendez holding qtx
+                std::lock_guard<qutex> lk(qtx);
+                not_empty.wakeup();
+            }
+            return true;
+        }
+
+        void send(T &&p) {
+            while (!try_send(p)) {
+                std::unique_lock<qutex> lk(qtx);
+                waiting w(send_waiters);
+                // recheck now that recv can see us
+                check_closed();
+                if (queue.enqueue(std::move(p))) {
+                    if (has_waiters(recv_waiters)) not_empty.wakeup();
+                    return;
+                }
+                not_full.sleep(lk);
+            }
+        }
+
+        bool try_recv(T &item) {
+            if (!queue.dequeue(item)) return false;
+            if (has_waiters(send_waiters)) {
+                std::lock_guard<qutex> lk(qtx);
+                not_full.wakeup();
+            }
+            return true;
+        }
+
+        T recv() {
+            T item;
+            while (!try_recv(item)) {
+                if (closed.load()) {
+                    // sends that raced with close
+                    if (try_recv(item)) break;
+                    throw channel_closed_error();
+                }
+                std::unique_lock<qutex> lk(qtx);
+                waiting w(recv_waiters);
+                // recheck now that send can see us
+                if (queue.dequeue(item)) {
+                    if (has_waiters(send_waiters)) not_full.wakeup();
+                    break;
+                }
+                if (closed.load()) continue;
+                not_empty.sleep(lk);
+            }
+            return item;
+        }
+
+        void close() {
+            closed = true;
+            // anyone who missed closed is in a rendez by the time we get qtx
+            std::lock_guard<qutex> lk(qtx);
+            not_empty.wakeupall();
+            not_full.wakeupall();
+        }
+    };
+};
+
+} // end namespace ten
+
+#endif // LIBTEN_BOUNDED_CHANNEL_HH
@@ -0,0 +1,90 @@
+#ifndef LIBTEN_BUFFER_PIPE_HH
+#define LIBTEN_BUFFER_PIPE_HH
+
+#include "ten/buffer.hh"
+#include "ten/channel.hh"
+#include <algorithm>
+
+namespace ten {
+
+//! stream of bytes between tasks in buffer segments, without copying
+//
+//! the writer takes an empty segment with get(), reads into it and
+//! hands it over with put(). the reader takes filled segments with
+//! next() and gives them back with release() once parsed. only
+//! nsegments buffers ever exist, so a slow reader stalls the writer
+//! in get() instead of growing memory. copies share the same pipe,
+//! like channel.
+//!
+//!     // reader task                  // parser task
+//!     auto seg = pipe.get();          auto seg = pipe.next();
+//!     seg->reserve(4096);             parse(seg->front(), seg->size());
+//!     ssize_t nr = s.recv(seg->back(), seg->available());
+//!     seg->commit(nr);                pipe.release(std::move(seg));
+//!     pipe.put(std::move(seg));
+class buffer_pipe {
+public:
+    typedef std::unique_ptr<buffer> segment;
+private:
+    channel<segment> _filled;
+    channel<segment> _free;
+public:
+    //! \param nsegments buffers in circulation, at least 1
+    //! \param segment_size initial capacity of each buffer
+    explicit buffer_pipe(size_t nsegments = 8, uint32_t segment_size = 16*1024)
+        // capacity 1 would make the channels synchronous
+        : _filled(std::max<size_t>(nsegments, 2)),
+        _free(std::max<size_t>(nsegments, 2))
+    {
+        CHECK(nsegments >= 1) << "buffer_pipe needs a segment";
+        for (size_t i = 0; i < nsegments; ++i) {
+            _free.send(segment(new buffer(segment_size)));
+        }
+    }
+
+    //! an empty segment to fill, waits until one is released
+    segment get() {
+        segment seg = _free.recv();
+        // recv hands out what is left after close, checked
+        // afterwards so a close racing with recv counts too
+        if (_free.is_closed()) throw channel_closed_error();
+        return seg;
+    }
+
+    //! hand a filled segment to the reader
+    void put(segment seg) {
+        _filled.send(std::move(seg));
+    }
+
+    //! the next filled segment, waits for one. after close, throws
+    //! channel_closed_error once the filled segments are used up
+    segment next() {
+        return _filled.recv();
+    }
+
+    //! give a segment back for reuse
+    void release(segment seg) {
+        seg->clear();
+        try {
+            _free.send(std::move(seg));
+        } catch (channel_closed_error &) {
+            // nobody will get() it again
+        }
+    }
+
+    //! no more segments, get() and put() throw channel_closed_error
+    void close() {
+        _filled.close();
+        _free.close();
+        // nothing will get() these, free them now
+        _free.clear();
+    }
+
+    bool is_closed() {
+        return _filled.is_closed();
+    }
+};
+
+} // end namespace ten
+
+#endif // LIBTEN_BUFFER_PIPE_HH
@@ -7,9 +7,13 @@
 #include <memory>
 #include <queue>
 #include <deque>
+#include <iterator>
+#include <limits>
 
 namespace ten {
 
+class alt;
+
 struct channel_closed_error : std::exception {
     virtual const char *what() const noexcept override {
         return "ten::channel_closed_error";
@@ -27,6 +31,7 @@ struct channel_closed_error : std::exception {
 //! channels are thread and task safe.
 template <typename T, typename ContainerT = std::deque<T> > class channel {
 private:
+    friend class alt;
     struct impl;
     std::shared_ptr<impl> _m;
     bool _autoclose;
@@ -61,6 +66,39 @@ public:
        return _m->recv(); 
     }
 
+    //! send every item in [first, last), moving them out
+    //
+    //! fills the buffer under one lock with one wakeup, and again
+    //! each time it had to wait for room. unbuffered channels
+    //! send one at a time. if the channel closes partway through,
+    //! stops and returns the count sent so far, throws
+    //! channel_closed_error only when nothing was sent.
+    //! \return number of items sent
+    template <typename Iter>
+    size_t send_n(Iter first, Iter last) {
+        return _m->send_n(first, last);
+    }
+
+    template <typename Range>
+    size_t send_n(Range &items) {
+        return send_n(std::begin(items), std::end(items));
+    }
+
+    //! wait for data, then receive up to max items into out
+    //! \return number of items received
+    template <typename OutputIt>
+    size_t recv_up_to(OutputIt out, size_t max) {
+        return _m->recv_up_to(out, max);
+    }
+
+    //! receive everything buffered into out without waiting
+    //! \return number of items received
+    template <typename OutputIt>
+    size_t drain(OutputIt out) {
+        std::lock_guard<qutex> lk(_m->qtx);
+        return _m->take_locked(out, std::numeric_limits<size_t>::max());
+    }
+
     bool empty() {
         return unread() == 0;
     }
@@ -88,7 +126,6 @@ private:
         typedef typename ContainerT::size_type size_type;
         impl(size_type capacity_=1) :
             capacity(capacity_),
-            queue(ContainerT()),
             closed(false)
         {
             CHECK(capacity_ >= 1) << "channel capacity must be >= 1";
@@ -96,8 +133,13 @@ private:
         impl(const impl &) = delete;
         impl &operator =(const impl &) = delete;
 
+        //! std::queue that can put an item back at the front
+        struct fifo : std::queue<T, ContainerT> {
+            void push_front(T &&p) { this->c.push_front(std::move(p)); }
+        };
+
         size_type capacity;
-        std::queue<T, ContainerT> queue;
+        fifo queue;
         qutex qtx;
         rendez not_empty;
         rendez not_full;
@@ -106,16 +148,24 @@ private:
         bool is_empty() const { return queue.empty(); }
         bool is_full() const { return queue.size() >= capacity; }
 
+        static void fill_slot(void *slot, void *p) {
+            static_cast<optional<T> *>(slot)->emplace(std::move(*static_cast<T *>(p)));
+        }
+
         size_type send(T &&p) {
             std::unique_lock<qutex> lk(qtx);
             bool synchronous = capacity == 1;
             size_type ret = queue.size();
+            if (synchronous && queue.empty() && !closed
+                    && not_empty.handoff(&fill_slot, &p)) {
+                // a receiver was waiting and has the item now
+                return ret;
+            }
             while (is_full() && !closed) {
                 not_full.sleep(lk);
             }
             check_closed();
-            queue.push(std::move(p));
-            not_empty.wakeup();
+            push_locked(std::move(p));
             if (synchronous) {
                 // wait for recv to complete
                 while (is_full() && !closed) {
@@ -127,16 +177,45 @@ private:
 
         T recv() {
             std::unique_lock<qutex> lk(qtx);
-            bool synchronous = capacity == 1;
+            if (capacity == 1) {
+                // synchronous, let send hand us the item directly
+                optional<T> slot;
+                while (is_empty() && !closed) {
+                    sleep_for_handoff(lk, slot);
+                    if (slot) return std::move(*slot);
+                }
+            }
             while (is_empty() && !closed) {
                 not_empty.sleep(lk);
             }
             if (queue.empty()) {
                 check_closed();
             }
+            return pop_locked();
+        }
+
+        void sleep_for_handoff(std::unique_lock<qutex> &lk, optional<T> &slot) {
+            try {
+                not_empty.sleep_handoff(lk, &slot);
+            } catch (...) {
+                if (slot) {
+                    // interrupted after send handed us the item.
+                    // it was sent before anything queued since,
+                    // so the next recv takes it first
+                    qtx.lock(qutex::safe_lock);
+                    queue.push_front(std::move(*slot));
+                    not_empty.wakeup();
+                    qtx.unlock();
+                }
+                throw;
+            }
+        }
+
+        //! take the front item, holding qtx
+        T pop_locked() {
             T item(std::move(queue.front()));
             queue.pop();
-            if (synchronous) {
+            if (capacity == 1) {
                 // wake up all because some senders might
                 // we blocked waiting for recv to complete
                 // others might be blocked waiting to send
@@ -147,6 +226,77 @@ private:
             return item;
         }
 
+        //! add an item without waiting for recv, holding qtx
+        void push_locked(T &&p) {
+            queue.push(std::move(p));
+            not_empty.wakeup();
+        }
+
+        template <typename Iter>
+        size_t send_n(Iter first, Iter last) {
+            size_t n = 0;
+            if (capacity == 1) {
+                try {
+                    for (; first != last; ++first, ++n) {
+                        send(std::move(*first));
+                    }
+                } catch (channel_closed_error &) {
+                    if (n == 0) throw;
+                }
+                return n;
+            }
+            std::unique_lock<qutex> lk(qtx);
+            while (first != last) {
+                while (is_full() && !closed) {
+                    not_full.sleep(lk);
+                }
+                if (closed) {
+                    // like recv_up_to, report what got through
+                    if (n == 0) check_closed();
+                    break;
+                }
+                size_t k = 0;
+                for (; first != last && !is_full(); ++first, ++k) {
+                    queue.push(std::move(*first));
+                }
+                n += k;
+                if (k == 1) {
+                    not_empty.wakeup();
+                } else {
+                    not_empty.wakeupall();
+                }
+            }
+            return n;
+        }
+
+        template <typename OutputIt>
+        size_t recv_up_to(OutputIt out, size_t max) {
+            std::unique_lock<qutex> lk(qtx);
+            while (is_empty() && !closed) {
+                not_empty.sleep(lk);
+            }
+            if (queue.empty()) {
+                check_closed();
+            }
+            return take_locked(out, max);
+        }
+
+        //! move up to max items to out, holding qtx
+        template <typename OutputIt>
+        size_t take_locked(OutputIt out, size_t max) {
+            size_t k = 0;
+            for (; k < max && !queue.empty(); ++k) {
+                *out++ = std::move(queue.front());
+                queue.pop();
+            }
+            if (k == 1 && capacity != 1) {
+                not_full.wakeup();
+            } else if (k > 0) {
+                not_full.wakeupall();
+            }
+            return k;
+        }
+
         void check_closed() {
             // i dont like throwing an exception for this
             // but i don't want to complicate the interface for send/recv
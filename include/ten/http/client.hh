@@ -252,6 +252,7 @@ protected:
     {
         const std::chrono::milliseconds interval{500 * std::min((std::chrono::milliseconds::rep)20L, lifetime->count())};
         VLOG(3) << im->name << ": LT interval=" << interval.count();
+        this_task::set_priority(task_priority::background);
         for (;;) {
             std::vector<res_ptr> doomed; // declared first, destroyed last
             std::unique_lock<qutex> lk(im->mut);
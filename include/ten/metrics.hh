@@ -308,6 +308,11 @@ inline void record(Func &&f) {
     synchronize(*tls_group.get(), f);
 }
 
+//! add this thread's scheduler stats (see kernel::thread_ready_stats)
+// to its metric group under "ten.sched", as the change since the last call.
+// only covers the calling thread, other threads call it themselves
+void record_scheduler();
+
 // singleton global metrics, accumulated from individual activities,
 //   which are not themselves synchronized
 
@@ -408,6 +413,9 @@ public:
 //----------------------------------------------------------------
 // time sequence collection
 
+//! snapshots of the global metrics every interval, keeping depth of them.
+// each snapshot records the scheduler stats of the thread that created
+// this, see record_scheduler for the others
 class intervals {
     using interval_type = std::chrono::seconds;
     using value_type = std::pair<time_t, group_map>;
@@ -30,6 +30,8 @@
 #define LIBTEN_MPMC_BOUNDED_QUEUE_HH
 
 #include <atomic>
+#include <utility>
+#include <cstdint>
 
 namespace ten {
 
@@ -77,53 +79,68 @@ public:
     }
 
     bool enqueue(T const& data) {
+        std::size_t pos;
+        cell_t* cell = claim_enqueue(pos);
+        if (!cell) return false;
+        cell->data_ = data;
+        cell->sequence_.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool enqueue(T&& data) {
+        std::size_t pos;
+        cell_t* cell = claim_enqueue(pos);
+        if (!cell) return false;
+        cell->data_ = std::move(data);
+        cell->sequence_.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool dequeue(T& data) {
         cell_t* cell;
-        std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        std::size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
         for (;;) {
             cell = &buffer_[pos & buffer_mask_];
             std::size_t seq = cell->sequence_.load(std::memory_order_acquire);
-            intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+            intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
             if (dif == 0) {
-                if (enqueue_pos_.compare_exchange_weak(
+                if (dequeue_pos_.compare_exchange_weak(
                             pos, pos + 1, std::memory_order_relaxed)) {
                     break;
                 }
             } else if (dif < 0) {
                 return false;
             } else {
-                pos = enqueue_pos_.load(std::memory_order_relaxed);
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
             }
         }
 
-        cell->data_ = data;
-        cell->sequence_.store(pos + 1, std::memory_order_release);
+        data = std::move(cell->data_);
+        cell->sequence_.store(pos + buffer_mask_ + 1, std::memory_order_release);
 
         return true;
     }
 
-    bool dequeue(T& data) {
+private:
+    //! reserve the next cell for writing, null if the queue is full
+    cell_t* claim_enqueue(std::size_t& pos) {
         cell_t* cell;
-        std::size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
         for (;;) {
             cell = &buffer_[pos & buffer_mask_];
             std::size_t seq = cell->sequence_.load(std::memory_order_acquire);
-            intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+            intptr_t dif = (intptr_t)seq - (intptr_t)pos;
             if (dif == 0) {
-                if (dequeue_pos_.compare_exchange_weak(
+                if (enqueue_pos_.compare_exchange_weak(
                             pos, pos + 1, std::memory_order_relaxed)) {
-                    break;
+                    return cell;
                 }
             } else if (dif < 0) {
-                return false;
+                return nullptr;
             } else {
-                pos = dequeue_pos_.load(std::memory_order_relaxed);
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
             }
         }
-
-        data = cell->data_;
-        cell->sequence_.store(pos + buffer_mask_ + 1, std::memory_order_release);
-
-        return true;
     }
 };
 
@@ -30,6 +30,13 @@ ssize_t netsend(int fd, const void *buf, size_t len, int flags, optional_timeout
 
 //! pure-virtual wrapper around socket_fd
 class sockbase {
+    //! s is registered with fdregister
+    bool _edge = false;
+
+    void unregister() {
+        if (_edge && s.valid()) fdunregister(s.fd);
+        _edge = false;
+    }
 public:
     socket_fd s;
 
@@ -43,14 +50,38 @@ public:
     sockbase(const sockbase &) = delete;
     sockbase &operator =(const sockbase &) = delete;
 
-    sockbase(sockbase &&other) = default;
-    sockbase &operator = (sockbase &&other) = default;
+    sockbase(sockbase &&other) noexcept
+        : _edge(other._edge), s(std::move(other.s))
+    {
+        other._edge = false;
+    }
+    sockbase &operator = (sockbase &&other) {
+        if (this != &other) {
+            unregister();
+            s = std::move(other.s);
+            std::swap(_edge, other._edge);
+        }
+        return *this;
+    }
 
-    virtual ~sockbase() {}
+    virtual ~sockbase() { unregister(); }
 
-    void close() { s.close(); }
+    void close() {
+        unregister();
+        s.close();
+    }
     bool valid() const { return s.valid(); }
 
+    //! register the socket with this thread's epoll once, edge-triggered,
+    // instead of re-arming it with epoll_ctl on every blocking recv or
+    // send. the socket must then only be used and closed by this thread.
+    // call once connected, an unconnected socket reports EPOLLHUP
+    void set_edge_triggered() {
+        if (_edge) return;
+        fdregister(s.fd);
+        _edge = true;
+    }
+
     int fcntl(int cmd) { return s.fcntl(cmd); }
     int fcntl(int cmd, long arg) { return s.fcntl(cmd, arg); }
 
@@ -86,6 +117,13 @@ public:
         s.setsockopt(level, optname, optval);
     }
 
+    //! SO_BUSY_POLL, busy poll the device queue for up to us on reads
+    // instead of waiting for the interrupt. pair with kernel::set_busy_poll.
+    // raising it above net.core.busy_read needs CAP_NET_ADMIN
+    void set_busy_poll(std::chrono::microseconds us) {
+        s.setsockopt(SOL_SOCKET, SO_BUSY_POLL, static_cast<int>(us.count()));
+    }
+
     virtual void dial(const char *addr,
             uint16_t port,
             optional_timeout timeout_ms=nullopt) = 0;
@@ -141,7 +179,7 @@ public:
     netsock(netsock &&other) = default;
     netsock &operator = (netsock &&other) = default;
 
-    //! dial requires a large 8MB stack size for getaddrinfo; throws on error
+    //! resolve addr with c-ares and connect, no large stack needed; throws on error
     void dial(const char *addr,
             uint16_t port,
             optional_timeout timeout_ms=nullopt) override;
@@ -19,6 +19,11 @@ const char * taskname(const char *fmt=nullptr, ...);
 int taskpoll(pollfd *fds, nfds_t nfds, optional_timeout ms=nullopt);
 //! suspend task waiting for io on fd
 bool fdwait(int fd, int rw, optional_timeout ms=nullopt);
+//! keep fd in this thread's epoll, edge-triggered, until fdunregister.
+// waits on it skip epoll_ctl. fdunregister must be called before close,
+// on the same thread; without a scheduler it does nothing
+void fdregister(int fd);
+void fdunregister(int fd);
 
 } // ten
 
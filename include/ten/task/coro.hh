@@ -0,0 +1,406 @@
+#ifndef LIBTEN_TASK_CORO_HH
+#define LIBTEN_TASK_CORO_HH
+
+#include "ten/task/task.hh"
+#include "ten/task/rendez.hh"
+#include "ten/descriptors.hh"
+#include "ten/optional.hh"
+#include <exception>
+#include <poll.h>
+#include <sys/socket.h>
+
+namespace ten {
+
+//! stackless tasks built on c++20 coroutines
+//
+//! a coroutine task keeps its locals in a heap allocated frame of a few
+//! hundred bytes instead of a full task stack, which suits large numbers
+//! of mostly idle connections. coroutines run on a per-thread runner task
+//! in the same scheduler as ordinary tasks and wait on the same io and
+//! alarms. they must only suspend with co_await, channels are awaited
+//! with coro::recv, coro::send and coro::wait on an alt. calling a
+//! task-blocking function like ten::netrecv blocks every coroutine on
+//! that thread, so waiting in rendez or on a contended qutex from a
+//! coroutine throws errorx instead.
+class alt;
+
+namespace coro {
+
+namespace detail {
+
+//! a suspended coroutine, resumed by this thread's runner
+struct waiter {
+    void *handle = nullptr;
+    void (*resume)(void *handle) = nullptr;
+    pollfd pfd{-1, 0, 0};
+    //! deadline and key in the runner's timers, timer_id is 0 when unarmed
+    kernel::time_point deadline;
+    uint64_t timer_id = 0;
+    //! pfd is registered with io
+    bool registered = false;
+    //! in the runner's ready queue
+    bool queued = false;
+};
+
+//! resume w on the next runner pass
+void post(waiter &w);
+//! resume w when fd is ready for rw ('r' or 'w') or at the deadline.
+// fd -1 only waits for the deadline
+void arm(waiter &w, int fd, int rw, optional<kernel::time_point> deadline);
+//! undo arm after resuming, true if the fd is ready
+bool disarm(waiter &w);
+
+//! bookkeeping for spawned coroutines, finished logs unhandled exceptions
+void started();
+void finished(std::exception_ptr exception);
+
+//! the current task is this thread's coroutine runner. blocking it in
+// qutex or rendez would stall every coroutine on the thread
+bool on_runner();
+
+//! a coroutine waiting on the cases of an alt, resumed by whichever
+// channel claims it. the claim may come from any thread
+struct alt_waiter : rendez::alt_waiter {
+    waiter w;
+    ten::alt *a = nullptr;
+    //! runner of the thread the coroutine waits on
+    void *owner = nullptr;
+};
+
+//! queue w on every case of a. \return false if it was not queued
+// because a case is ready or busy, then poll again
+bool arm(alt_waiter &w, ten::alt &a);
+//! undo arm after resuming
+void disarm(alt_waiter &w);
+
+} // detail
+
+} // coro
+} // ten
+
+#if __cplusplus > 201703L && defined(__cpp_impl_coroutine)
+
+#include "ten/alt.hh"
+#include <coroutine>
+#include <utility>
+
+namespace ten {
+namespace coro {
+
+template <class T=void> class task;
+
+namespace detail {
+
+inline void resume_handle(void *handle) {
+    std::coroutine_handle<>::from_address(handle).resume();
+}
+
+struct promise_base {
+    //! coroutine awaiting this one, resumed when it finishes
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+    //! started with spawn, nobody awaits the result
+    bool detached = false;
+    //! used to start a detached coroutine
+    waiter start;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct final_awaiter {
+        bool await_ready() noexcept { return false; }
+
+        template <class Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept {
+                promise_base &p = h.promise();
+                if (p.detached) {
+                    std::exception_ptr e = std::move(p.exception);
+                    h.destroy();
+                    finished(std::move(e));
+                    return std::noop_coroutine();
+                }
+                if (p.continuation) return p.continuation;
+                return std::noop_coroutine();
+            }
+
+        void await_resume() noexcept {}
+    };
+
+    final_awaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { exception = std::current_exception(); }
+};
+
+template <class T>
+struct promise : promise_base {
+    optional<T> value;
+
+    task<T> get_return_object() noexcept;
+
+    template <class U>
+        void return_value(U &&v) { value.emplace(std::forward<U>(v)); }
+
+    T result() {
+        if (exception) std::rethrow_exception(exception);
+        return std::move(*value);
+    }
+};
+
+template <>
+struct promise<void> : promise_base {
+    task<void> get_return_object() noexcept;
+
+    void return_void() noexcept {}
+
+    void result() {
+        if (exception) std::rethrow_exception(exception);
+    }
+};
+
+//! suspends until the fd is ready or the deadline passes
+struct wait_awaiter {
+    waiter w;
+    int fd;
+    int rw;
+    optional<kernel::time_point> deadline;
+
+    wait_awaiter(int fd_, int rw_, optional<kernel::time_point> deadline_)
+        : fd{fd_}, rw{rw_}, deadline{deadline_} {}
+
+    bool await_ready() const noexcept {
+        return fd < 0 && deadline && *deadline <= kernel::now();
+    }
+
+    void await_suspend(std::coroutine_handle<> h) {
+        w.handle = h.address();
+        w.resume = &resume_handle;
+        arm(w, fd, rw, deadline);
+    }
+
+    bool await_resume() { return disarm(w); }
+};
+
+//! suspends until a case of an alt may be ready
+struct alt_awaiter {
+    alt_waiter w;
+    ten::alt &a;
+
+    explicit alt_awaiter(ten::alt &a_) : a(a_) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> h) {
+        w.w.handle = h.address();
+        w.w.resume = &resume_handle;
+        return arm(w, a);
+    }
+
+    void await_resume() { disarm(w); }
+};
+
+struct yield_awaiter {
+    waiter w;
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> h) {
+        w.handle = h.address();
+        w.resume = &resume_handle;
+        post(w);
+    }
+
+    void await_resume() noexcept {}
+};
+
+} // detail
+
+//! a lazily started coroutine returning T
+//
+//! co_await runs it to completion and returns its result or rethrows
+//! its exception. a task<void> can also be handed to spawn.
+template <class T>
+class task {
+public:
+    typedef detail::promise<T> promise_type;
+
+private:
+    std::coroutine_handle<promise_type> _h;
+
+    template <class U> friend struct detail::promise;
+    friend void spawn(task<void> t);
+
+    explicit task(std::coroutine_handle<promise_type> h) : _h{h} {}
+
+public:
+    task(task &&other) noexcept : _h{std::exchange(other._h, nullptr)} {}
+    task &operator = (task &&other) noexcept {
+        if (this != &other) {
+            if (_h) _h.destroy();
+            _h = std::exchange(other._h, nullptr);
+        }
+        return *this;
+    }
+    task(const task &) = delete;
+    task &operator = (const task &) = delete;
+
+    ~task() {
+        if (_h) _h.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        _h.promise().continuation = awaiting;
+        return _h;
+    }
+
+    T await_resume() { return _h.promise().result(); }
+};
+
+namespace detail {
+
+template <class T>
+task<T> promise<T>::get_return_object() noexcept {
+    return task<T>{std::coroutine_handle<promise<T>>::from_promise(*this)};
+}
+
+inline task<void> promise<void>::get_return_object() noexcept {
+    return task<void>{std::coroutine_handle<promise<void>>::from_promise(*this)};
+}
+
+} // detail
+
+//! start t on this thread's coroutine runner, it owns itself from now on.
+// must be called from a task, the thread stays up until it finishes
+inline void spawn(task<void> t) {
+    auto h = std::exchange(t._h, nullptr);
+    auto &p = h.promise();
+    p.detached = true;
+    p.start.handle = h.address();
+    p.start.resume = &detail::resume_handle;
+    detail::started();
+    detail::post(p.start);
+}
+
+//! let other coroutines and tasks run
+inline detail::yield_awaiter yield() {
+    return {};
+}
+
+inline detail::wait_awaiter sleep_until(const kernel::time_point &when) {
+    return {-1, 0, when};
+}
+
+template <class Rep, class Period>
+    detail::wait_awaiter sleep_for(std::chrono::duration<Rep, Period> d) {
+        return {-1, 0, kernel::now() + d};
+    }
+
+//! co_await yields false on timeout, error or hangup, like ten::fdwait
+inline detail::wait_awaiter fdwait(int fd, int rw, optional_timeout ms=nullopt) {
+    optional<kernel::time_point> deadline;
+    if (ms) deadline = kernel::now() + *ms;
+    return {fd, rw, deadline};
+}
+
+//! complete one case of a, like alt::wait without a timeout.
+// a must outlive the co_await
+inline task<int> wait(ten::alt &a) {
+    for (;;) {
+        bool busy = false;
+        int i = a.try_wait(busy);
+        if (i >= 0) co_return i;
+        if (busy) {
+            // a task holds a channel lock, let it run
+            co_await yield();
+        } else {
+            co_await detail::alt_awaiter{a};
+        }
+    }
+}
+
+//! awaitable channel::recv, throws channel_closed_error once the
+// channel is closed and empty
+template <class T, class ContainerT>
+task<T> recv(channel<T, ContainerT> ch) {
+    T out{};
+    ten::alt a;
+    a.recv(ch, out);
+    co_await wait(a);
+    if (a.closed()) throw channel_closed_error();
+    co_return std::move(out);
+}
+
+//! awaitable channel::send. like a send in an alt, on an unbuffered
+// channel it completes once the item is queued
+template <class T, class ContainerT>
+task<> send(channel<T, ContainerT> ch, T value) {
+    ten::alt a;
+    a.send(ch, std::move(value));
+    co_await wait(a);
+    if (a.closed()) throw channel_closed_error();
+}
+
+namespace detail {
+
+inline void set_errno_from(int fd, int default_err) {
+    int e = default_err;
+    socklen_t len = sizeof e;
+    // a plain timeout leaves SO_ERROR at zero
+    if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &e, &len) == 0 && e == 0) {
+        e = default_err;
+    }
+    errno = e;
+}
+
+} // detail
+
+//! awaitable ten::netrecv
+inline task<ssize_t> netrecv(int fd, void *buf, size_t len, int flags=0,
+        optional_timeout ms=nullopt)
+{
+    ssize_t nr;
+    while ((nr = ::recv(fd, buf, len, flags)) < 0) {
+        if (errno == EINTR)
+            continue;
+        if (!io_not_ready())
+            break;
+        if (!co_await fdwait(fd, 'r', ms)) {
+            detail::set_errno_from(fd, ETIMEDOUT);
+            break;
+        }
+    }
+    co_return nr;
+}
+
+//! awaitable ten::netsend
+inline task<ssize_t> netsend(int fd, const void *buf, size_t len, int flags=0,
+        optional_timeout ms=nullopt)
+{
+    size_t total_sent = 0;
+    while (total_sent < len) {
+        ssize_t nw = ::send(fd, static_cast<const char *>(buf) + total_sent,
+                len - total_sent, flags);
+        if (nw == -1) {
+            if (errno == EINTR)
+                continue;
+            if (!io_not_ready()) {
+                co_return total_sent ? ssize_t(total_sent) : -1;
+            }
+            if (!co_await fdwait(fd, 'w', ms)) {
+                if (total_sent) co_return total_sent;
+                detail::set_errno_from(fd, ETIMEDOUT);
+                co_return -1;
+            }
+        } else {
+            total_sent += nw;
+        }
+    }
+    co_return total_sent;
+}
+
+} // coro
+} // ten
+
+#endif // coroutines
+
+#endif // LIBTEN_TASK_CORO_HH
@@ -31,6 +31,84 @@ public:
     //! perform clean shutdown
     static void shutdown();
 
+    //! let timeouts in this thread fire up to slack late so they can
+    // share one timer wakeup, also sets the thread's kernel timer slack
+    static void set_timer_slack(std::chrono::nanoseconds slack);
+
+    //! busy-poll for up to max before sleeping in this thread.
+    // trades cpu for latency, the budget shrinks while polling finds
+    // nothing and grows back when it does. zero, the default, disables
+    static void set_busy_poll(std::chrono::microseconds max);
+
+    //! ready queue depth per task_priority class for this thread
+    struct ready_stats {
+        static constexpr size_t nclasses = 3;
+        //! tasks ready now
+        size_t depth[nclasses] = {};
+        //! most tasks ready at once
+        size_t max_depth[nclasses] = {};
+        //! tasks taken off the queue
+        uint64_t runs[nclasses] = {};
+        //! runs given to a class only because it was starving
+        uint64_t starved[nclasses] = {};
+
+        static constexpr size_t nwait = 21;
+        //! wait[i] counts tasks that waited at most 1us << i between
+        // being readied and running, the last bucket counts longer waits
+        uint64_t wait[nwait] = {};
+        //! time tasks spent running between swaps
+        duration run_time{0};
+    };
+
+    //! ready queue and run time stats for this thread
+    static ready_stats thread_ready_stats();
+
+    //! run tasks holding a deadline earliest deadline first
+    // within their priority class in this thread. default off
+    static void set_deadline_scheduling(bool on);
+
+    //! stack usage of tasks that exited on this thread
+    struct stack_stats {
+        static constexpr size_t nbuckets = 10;
+        //! stacks released by exiting tasks
+        uint64_t released = 0;
+        //! released stacks that were measured and trimmed
+        uint64_t sampled = 0;
+        //! bytes of stack given back to the os with madvise by sampled stacks
+        uint64_t reclaimed = 0;
+        //! unmeasured stacks trimmed after sitting idle in a cache
+        uint64_t trimmed = 0;
+        //! highwater[i] counts sampled tasks whose stack high-water mark
+        // was at most 4k << i, the last bucket counts everything deeper.
+        // measured from resident pages, so a task on a reused stack
+        // reports at least what the cache kept of the previous one.
+        uint64_t highwater[nbuckets] = {};
+    };
+
+    //! stack stats for this thread
+    static stack_stats thread_stack_stats();
+
+    //! epoll syscalls made by this thread's io
+    struct io_stats {
+        //! epoll_ctl calls to add, modify and remove fds
+        uint64_t ctl = 0;
+        //! epoll_wait calls
+        uint64_t wait = 0;
+        //! waits on edge-triggered fds that found an event already
+        // there and did not suspend
+        uint64_t edge_ready = 0;
+    };
+
+    //! io stats for this thread, zero if it never waited on io
+    static io_stats thread_io_stats();
+
+    //! every sample_every task exits, measure the stack and release
+    // the pages deeper than keep_bytes with madvise before caching it.
+    // stacks too big to cache are always measured. the other cached
+    // stacks are trimmed the same way once they sit unused for 256
+    // exits. keep_bytes must be at least a page. default 64k and 32
+    static void set_stack_reclaim(size_t keep_bytes, unsigned sample_every=32);
+
     //! this is only a tribute
     static int32_t is_computer_on();
     static double is_computer_on_fire();
@@ -0,0 +1,64 @@
+#ifndef LIBTEN_TASK_PROC_GROUP_HH
+#define LIBTEN_TASK_PROC_GROUP_HH
+
+#include "ten/task/kernel.hh"
+#include <memory>
+#include <functional>
+
+namespace ten {
+
+//! a group of scheduler threads that share work
+//
+//! tasks spawned into the group are queued in a per-thread work-stealing
+//! deque. threads with nothing to do steal tasks from busy threads.
+//! only tasks that have not started running are stolen; once a task
+//! runs it stays on that thread because it owns thread-bound state
+//! like alarms and io registrations. spawn_on and spawn_balanced
+//! place a task on one thread and it is never stolen.
+class proc_group {
+public:
+    class impl;
+
+    //! start nthreads scheduler threads
+    explicit proc_group(size_t nthreads=kernel::cpu_count());
+    //! wait for all tasks spawned into the group, then join the threads
+    // must be called from a task outside the group
+    ~proc_group();
+
+    proc_group(const proc_group &) = delete;
+    proc_group &operator=(const proc_group &) = delete;
+
+    //! spawn a new task in the group
+    // when called from a group thread the task is queued locally,
+    // otherwise it is injected into the group
+    template <class Function>
+        void spawn(Function &&f) {
+            spawn_fn(std::function<void ()>{std::forward<Function>(f)});
+        }
+
+    //! spawn a new task on the group thread with index i, [0, size())
+    template <class Function>
+        void spawn_on(size_t i, Function &&f) {
+            spawn_on_fn(i, std::function<void ()>{std::forward<Function>(f)});
+        }
+
+    //! spawn a new task on the group thread with the fewest ready tasks
+    template <class Function>
+        void spawn_balanced(Function &&f) {
+            spawn_on_fn(least_loaded(), std::function<void ()>{std::forward<Function>(f)});
+        }
+
+    //! number of threads in the group
+    size_t size() const;
+
+private:
+    std::unique_ptr<impl> _impl;
+
+    void spawn_fn(std::function<void ()> f);
+    void spawn_on_fn(size_t i, std::function<void ()> f);
+    size_t least_loaded() const;
+};
+
+} // ten
+
+#endif // LIBTEN_TASK_PROC_GROUP_HH
@@ -4,25 +4,33 @@
 #include "ten/task.hh"
 #include "ten/ptr.hh"
 #include <mutex>
+#include <atomic>
 #include <deque>
 
 namespace ten {
 
 //! task aware mutex
+//
+//! the owner and a contended bit share one atomic word, so lock and
+//! unlock are a single compare-and-swap while there are no waiters.
+//! _m and the waiting list are only touched once the bit is set, and
+//! then unlock hands the lock straight to the first waiter.
 class qutex {
+public:
+    enum lock_type_t { interruptable_lock, safe_lock };
 private:
+    //! contended bit, set while tasks may be waiting
+    static constexpr uintptr_t waiters = 1;
+    //! owning task::impl pointer or zero, plus the contended bit
+    std::atomic<uintptr_t> _state;
     std::mutex _m;
     std::deque<ptr<task::impl>> _waiting;
-    ptr<task::impl> _owner;
 
+    void lock_slow(ptr<task::impl> t, lock_type_t lt);
+    void unlock_slow() noexcept;
     void unlock_or_giveup(std::lock_guard<std::mutex> &lk) noexcept;
 public:
-    enum lock_type_t { interruptable_lock, safe_lock };
-
-    qutex() : _owner(nullptr) {
-        // a simple memory barrier would be sufficient here
-        std::unique_lock<std::mutex> lk(_m);
-    }
+    qutex() : _state{0} {}
     qutex(const qutex &) = delete;
     qutex &operator =(const qutex &) = delete;
 
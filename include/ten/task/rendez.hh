@@ -7,9 +7,41 @@ namespace ten {
 
 //! task aware condition rendezvous point
 class rendez {
+public:
+    //! one task waiting on several rendez at once, see alt
+    //
+    //! the first wakeup to claim it readies the task, the rest
+    //! skip it and wake the next waiter instead
+    struct alt_waiter {
+        ptr<task::impl> t;
+        //! index of the rendez that claimed it, -1 while unclaimed
+        std::atomic<int> fired;
+        //! if set, called by the rendez that claimed it, holding the
+        // rendez lock and before t is readied. may run on any thread
+        void (*wake)(alt_waiter &w) = nullptr;
+
+        alt_waiter();
+        //! claim for index, false if already claimed
+        bool claim(int index) {
+            int unclaimed = -1;
+            return fired.compare_exchange_strong(unclaimed, index);
+        }
+    };
 private:
+    struct waiter {
+        ptr<task::impl> t;
+        alt_waiter *alt;
+        int index;
+        //! for handoff, null if the task takes none
+        void *slot;
+    };
     std::mutex _m;
-    std::deque<ptr<task::impl>> _waiting;
+    std::deque<waiter> _waiting;
+
+    //! pop the next waiter to wake, called holding _m
+    ptr<task::impl> take_one();
+    //! sleep, filling slot on handoff, no later than until
+    void sleep_impl(std::unique_lock<qutex> &lk, void *slot, optional<kernel::time_point> until);
 public:
     rendez() {}
     rendez(const rendez &) = delete;
@@ -26,8 +58,36 @@ public:
         }
     }
 
+    //! sleep like sleep(lk), but wake by when at the latest.
+    // timing out doesn't throw, so a deadline of the caller's still does
+    void sleep_until(std::unique_lock<qutex> &lk, kernel::time_point when);
+
+    //! \return false if pred is still false at when
+    template <typename Predicate>
+    bool sleep_until(std::unique_lock<qutex> &lk, kernel::time_point when, Predicate pred) {
+        while (!pred()) {
+            if (kernel::now() >= when) return false;
+            sleep_until(lk, when);
+        }
+        return true;
+    }
+
     void wakeup();
     void wakeupall();
+
+    //! sleep like sleep(lk), and let handoff fill slot
+    void sleep_handoff(std::unique_lock<qutex> &lk, void *slot);
+
+    //! fill the slot of the first task sleeping with one, and run
+    // that task before other ready tasks. call holding the qutex
+    // the sleepers use. \return false if no task was sleeping with a slot
+    bool handoff(void (*fill)(void *slot, void *arg), void *arg);
+
+    //! queue w, to be claimed for index. hold the qutex the
+    // condition is guarded by, like sleep
+    void add(alt_waiter &w, int index);
+    //! dequeue w if it is still queued
+    void remove(alt_waiter &w);
 };
 
 } // namespace
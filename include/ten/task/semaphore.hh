@@ -0,0 +1,72 @@
+#ifndef LIBTEN_TASK_SEMAPHORE_HH
+#define LIBTEN_TASK_SEMAPHORE_HH
+
+#include "ten/task/rendez.hh"
+
+namespace ten {
+
+//! task aware counting semaphore
+//
+//! unlike ten::semaphore, waiting only blocks the calling task
+class task_semaphore {
+private:
+    qutex _q;
+    rendez _r;
+    size_t _count;
+public:
+    explicit task_semaphore(size_t count = 0) : _count{count} {}
+    task_semaphore(const task_semaphore &) = delete;
+    task_semaphore &operator =(const task_semaphore &) = delete;
+
+    //! take one unit, waiting until one is released
+    void acquire();
+    //! take one unit if available without waiting
+    bool try_acquire();
+    //! wait up to ms for a unit, false on timeout
+    bool try_acquire_for(std::chrono::milliseconds ms);
+    //! return n units, waking up to n waiters
+    void release(size_t n = 1);
+};
+
+//! single use countdown, waiters wake when it reaches zero
+class latch {
+private:
+    qutex _q;
+    rendez _r;
+    size_t _count;
+public:
+    explicit latch(size_t count) : _count{count} {}
+    latch(const latch &) = delete;
+    latch &operator =(const latch &) = delete;
+
+    void count_down(size_t n = 1);
+    //! true if the count reached zero
+    bool try_wait();
+    void wait();
+    //! count_down then wait
+    void arrive_and_wait(size_t n = 1);
+};
+
+//! wait for a group of tasks to finish
+//
+//! add before spawning each task, done when it finishes, and the
+//! joiner's wait wakes once when the count drops to zero.
+//! can be reused once wait returns
+class wait_group {
+private:
+    qutex _q;
+    rendez _r;
+    size_t _count = 0;
+public:
+    wait_group() {}
+    wait_group(const wait_group &) = delete;
+    wait_group &operator =(const wait_group &) = delete;
+
+    void add(size_t n = 1);
+    void done();
+    void wait();
+};
+
+} // namespace
+
+#endif // LIBTEN_TASK_SEMAPHORE_HH
@@ -0,0 +1,50 @@
+#ifndef LIBTEN_TASK_SHARED_QUTEX_HH
+#define LIBTEN_TASK_SHARED_QUTEX_HH
+
+#include "ten/task/qutex.hh"
+
+namespace ten {
+
+//! task aware reader/writer lock
+//
+//! readers share the lock, a writer holds it alone. once a task has to
+//! wait, later lockers queue behind it, so a waiting writer is not
+//! starved by a stream of new readers. waiters are let in in order,
+//! consecutive readers together. uncontended lock and lock_shared are
+//! a single atomic operation. meets the SharedMutex requirements that
+//! std::shared_lock needs, use std::unique_lock for exclusive locking.
+class shared_qutex {
+private:
+    struct waiter;
+
+    static constexpr uint64_t readers_mask = 0xffffffff;
+    //! a writer holds the lock
+    static constexpr uint64_t writer = uint64_t{1} << 32;
+    //! tasks are queued, new lockers must queue too
+    static constexpr uint64_t pending = uint64_t{1} << 33;
+
+    //! reader count and the flags above
+    std::atomic<uint64_t> _state;
+    //! protects _waiting and changes to pending
+    std::mutex _m;
+    std::deque<waiter *> _waiting;
+
+    void lock_slow(bool exclusive, qutex::lock_type_t lt);
+    void grant();
+public:
+    shared_qutex() : _state{0} {}
+    shared_qutex(const shared_qutex &) = delete;
+    shared_qutex &operator =(const shared_qutex &) = delete;
+
+    void lock(qutex::lock_type_t lt = qutex::interruptable_lock);
+    void unlock();
+    bool try_lock();
+
+    void lock_shared(qutex::lock_type_t lt = qutex::interruptable_lock);
+    void unlock_shared();
+    bool try_lock_shared();
+};
+
+} // namespace
+
+#endif // LIBTEN_TASK_SHARED_QUTEX_HH
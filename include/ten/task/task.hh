@@ -8,6 +8,8 @@
 #include <chrono>
 #include <functional>
 #include <thread>
+#include <type_traits>
+#include <new>
 #include <sys/time.h>
 
 namespace ten {
@@ -27,11 +29,20 @@ inline D timeval_duration(timeval tv) {
 //! dummy type to smooth API change
 enum nostacksize_t { nostacksize };
 
+//! scheduling classes, ready tasks in a higher class run first
+enum class task_priority { critical, normal, background };
+
 namespace this_task {
 
 //! id of the current task
 uint64_t get_id();
 
+//! change the scheduling class of the current task
+void set_priority(task_priority p);
+
+//! scheduling class of the current task, normal by default
+task_priority get_priority();
+
 //! allow other tasks to run
 void yield();
 
@@ -68,9 +79,19 @@ public:
     task &operator=(task &&) = default;
 
     //! spawn a new task in the current thread
+    // the callable is moved onto the new task's stack
     template<class Function> 
         static task spawn(Function &&f) {
-            return task{f};
+            typename fn_ops_for<Function>::ref r{std::forward<Function>(f)};
+            return task{fn_ops_for<Function>::ops, &r, nullopt};
+        }
+
+    //! spawn a new task in the current thread with its own stack size
+    // rounded up to the stack allocator's next size class (16k, 64k, 256k or 1m)
+    template<class Function> 
+        static task spawn(Function &&f, size_t stacksize) {
+            typename fn_ops_for<Function>::ref r{std::forward<Function>(f)};
+            return task{fn_ops_for<Function>::ops, &r, stacksize};
         }
 
     //! spawn a new task in a new thread
@@ -95,14 +116,43 @@ public:
     void join();
 
 private:
+    //! type-erased callable stored at the top of the task's stack
+    struct fn_ops {
+        size_t size;
+        size_t align;
+        //! construct the callable in mem from the fn_ops_for::ref in arg
+        void (*construct)(void *mem, void *arg);
+        void (*invoke)(void *fn);
+        void (*destroy)(void *fn);
+    };
+
+    template <class Function>
+    struct fn_ops_for {
+        typedef typename std::decay<Function>::type F;
+        struct ref { Function &&f; };
+
+        static void construct(void *mem, void *arg) {
+            new (mem) F(std::forward<Function>(static_cast<ref *>(arg)->f));
+        }
+        static void invoke(void *fn) { (*static_cast<F *>(fn))(); }
+        static void destroy(void *fn) { static_cast<F *>(fn)->~F(); }
+
+        static const fn_ops ops;
+    };
+
     std::shared_ptr<impl> _impl;
 
-    explicit task(std::function<void ()> f);
+    task(const fn_ops &ops, void *arg, optional<size_t> stacksize);
 
     //! task entry boilerplate exception handling
     static int entry(std::function<void ()> f);
 };
 
+template <class Function>
+const task::fn_ops task::fn_ops_for<Function>::ops = {
+    sizeof(F), alignof(F), construct, invoke, destroy
+};
+
 } // end namespace ten
 
 
@@ -0,0 +1,37 @@
+#ifndef LIBTEN_TASK_TRACE_HH
+#define LIBTEN_TASK_TRACE_HH
+
+#include <ostream>
+#include <cstddef>
+
+namespace ten {
+
+//! scheduler event trace
+//
+//! while enabled every thread records spawn, swap in/out, cross-thread
+//! ready, io wait, alarm and exit events into its own fixed size ring
+//! buffer. cheap enough to turn on under real load, unlike TEN_TASK_TRACE.
+namespace trace {
+
+//! start recording, each thread keeps its last events_per_thread events.
+// the size is rounded up to a power of two and only applies to
+// threads that have not recorded anything yet
+void enable(size_t events_per_thread = 1 << 16);
+
+//! stop recording, the events recorded so far are kept
+void disable();
+
+bool enabled();
+
+//! write the recorded events of all threads as chrome trace json,
+// viewable in chrome://tracing or ui.perfetto.dev
+void dump_chrome_json(std::ostream &o);
+
+//! forget recorded events and the buffers of exited threads
+void clear();
+
+} // trace
+
+} // ten
+
+#endif
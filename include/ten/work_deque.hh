@@ -3,7 +3,9 @@
 #include "ten/optional.hh"
 #include <memory>
 #include <atomic>
+#include <vector>
 #include <cmath>
+#include <sys/types.h>
 
 // Chase/Lev work-stealing deque
 // from Dynamic Circular Work-Stealing Deque
@@ -26,6 +28,9 @@ private:
     std::atomic<size_t> _bottom;
     std::atomic<array *> _array;
     cacheline_pad_t pad1_;
+    // arrays replaced by grow(). stealers may still be reading from them
+    // so they are only freed with the deque. only touched by the owner.
+    std::vector<std::unique_ptr<array>> _retired;
 public:
     work_deque(size_t size) : _top{0}, _bottom{0} {
         _array.store(new array{(size_t)std::log(size)}, std::memory_order_seq_cst);
@@ -43,7 +48,7 @@ public:
         if (b - t > a->size() - 1) {
             a = a->grow(t, b).release();
             size_t ss = a->size();
-            std::unique_ptr<array> old{_array.exchange(a, std::memory_order_seq_cst)};
+            _retired.emplace_back(_array.exchange(a, std::memory_order_seq_cst));
             _bottom.store(b + ss, std::memory_order_seq_cst);
             t = _top.load(std::memory_order_seq_cst);
             if (!_top.compare_exchange_strong(t, t + ss,
@@ -64,7 +69,8 @@ public:
         _bottom.store(b, std::memory_order_release);
         size_t t = _top.load(std::memory_order_seq_cst); 
         optional<T> x;
-        if (t <= b) {
+        // signed compare because b wraps when taking from a fresh deque
+        if ((ssize_t)(b - t) >= 0) {
             // non-empty queue
             x = a->get(b);
             if (t == b) {
@@ -84,6 +90,13 @@ public:
         return x;
     }
 
+    // approximate, only useful as a hint
+    bool empty() const {
+        size_t b = _bottom.load(std::memory_order_seq_cst);
+        size_t t = _top.load(std::memory_order_seq_cst);
+        return (ssize_t)(b - t) <= 0;
+    }
+
     // pop_front
     // pair of
     //  bool success? - false means try again
@@ -2,102 +2,303 @@
 #define TEN_TASK_ALARM_HH
 
 #include <chrono>
-#include <vector>
+#include <exception>
 #include <algorithm>
 #include "ten/optional.hh"
 #include "ten/ptr.hh"
 
 namespace ten {
 
+//! hierarchical timing wheel
+//
+//! the first level has one slot per millisecond for the next 256ms,
+//! the other levels have 64 slots each covering 64 slots of the level
+//! below. alarms live in an intrusive list node inside scoped_alarm, so
+//! arming and canceling are O(1). alarms further out than the wheel
+//! covers (about 18 hours) wait in the last slot and are re-filed.
+//! alarms in the same millisecond fire in the order they were armed.
 template <class T, class Clock>
 struct alarm_clock {
     typedef typename Clock::time_point time_point;
     typedef typename Clock::duration   duration;
+    typedef std::chrono::milliseconds  resolution;
 
 private:
-    struct data {
+    static constexpr unsigned root_bits = 8;
+    static constexpr unsigned level_bits = 6;
+    static constexpr unsigned nlevels = 4;
+    static constexpr uint64_t root_size = uint64_t{1} << root_bits;
+    static constexpr uint64_t level_size = uint64_t{1} << level_bits;
+    static constexpr uint64_t max_range = uint64_t{1} << (root_bits + (nlevels-1) * level_bits);
+
+    struct link {
+        link *prev = nullptr;
+        link *next = nullptr;
+
+        bool linked() const { return next != nullptr; }
+
+        // list heads point to themselves when empty
+        void make_head() { prev = next = this; }
+        bool empty() const { return next == this; }
+
+        void push_back(link *n) {
+            n->prev = prev;
+            n->next = this;
+            prev->next = n;
+            prev = n;
+        }
+
+        void unlink() {
+            prev->next = next;
+            next->prev = prev;
+            prev = next = nullptr;
+        }
+
+        //! take the place of other in its list
+        void replace(link &other) {
+            prev = other.prev;
+            next = other.next;
+            prev->next = this;
+            next->prev = this;
+            other.prev = other.next = nullptr;
+        }
+
+        //! move all nodes from this list to the empty list head
+        void splice_to(link &head) {
+            if (empty()) return;
+            head.next = next;
+            head.prev = prev;
+            next->prev = &head;
+            prev->next = &head;
+            make_head();
+        }
+    };
+
+    struct node : link {
         T value;
         time_point when;
         std::exception_ptr exception;
+        unsigned level = 0;
+    };
 
-        bool operator == (const data &other) {
-            if (value == other.value
-                    && when == other.when
-                    && exception == other.exception)
-            {
-                return true;
-            }
-            return false;
+    link _root[root_size];
+    link _levels[nlevels-1][level_size];
+    size_t _count[nlevels] = {};
+    //! all ticks before this have been processed
+    uint64_t _cur = 0;
+    //! cached result of when()
+    optional<time_point> _when;
+
+    static uint64_t to_tick(const time_point &tp) {
+        const auto t = std::chrono::duration_cast<resolution>(tp.time_since_epoch()).count();
+        return t < 0 ? 0 : t;
+    }
+
+    static time_point from_tick(uint64_t t) {
+        return time_point{std::chrono::duration_cast<duration>(resolution{t})};
+    }
+
+    static constexpr unsigned shift(unsigned level) {
+        return root_bits + (level - 1) * level_bits;
+    }
+
+    link &slot(unsigned level, uint64_t tick) {
+        if (level == 0) {
+            return _root[tick & (root_size - 1)];
         }
-    };
+        return _levels[level-1][(tick >> shift(level)) & (level_size - 1)];
+    }
 
-    typedef std::vector<data> container_type;
-    container_type _set;
+    size_t total() const {
+        size_t n = 0;
+        for (auto c : _count) n += c;
+        return n;
+    }
 
-    struct order {
-        bool operator ()(const data &a, const data &b) const {
-            return a.when < b.when;
+    void place(node &n) {
+        uint64_t t = std::max(to_tick(n.when), _cur);
+        const uint64_t delta = t - _cur;
+        unsigned level = 0;
+        if (delta >= root_size) {
+            level = 1;
+            while (level < nlevels - 1 && delta >= (uint64_t{1} << shift(level+1))) {
+                ++level;
+            }
+            if (delta >= max_range) {
+                t = _cur + max_range - 1;
+            }
         }
-    };
+        n.level = level;
+        slot(level, t).push_back(&n);
+        ++_count[level];
+    }
+
+    void insert(node &n) {
+        if (total() == 0) {
+            // _cur might be far behind if tick hasn't been called lately
+            _cur = std::max(_cur, to_tick(Clock::now()));
+        }
+        place(n);
+        if (_when && n.when < *_when) {
+            _when = n.when;
+        }
+    }
 
-    data insert(const T &t, const time_point &when) {
-        data d{t, when};
-        auto i = std::lower_bound(std::begin(_set),
-                std::end(_set), d, order());
-        _set.insert(i, d);
-        return d;
+    void remove(node &n) {
+        if (!n.linked()) return;
+        --_count[n.level];
+        n.unlink();
+        if (_when && *_when == n.when) {
+            _when = nullopt;
+        }
     }
 
-    template<typename Exception>
-    data insert(const T &t, const time_point &when, Exception e) {
-        data d{t, when, std::make_exception_ptr(e)};
-        auto i = std::lower_bound(std::begin(_set),
-                std::end(_set), d, order());
-        _set.insert(i, d);
-        return d;
+    //! refile the higher level slots that _cur just reached
+    void cascade() {
+        for (unsigned level = 1; level < nlevels; ++level) {
+            if (_count[level]) {
+                link tmp;
+                tmp.make_head();
+                slot(level, _cur).splice_to(tmp);
+                while (!tmp.empty()) {
+                    node &n = static_cast<node &>(*tmp.next);
+                    n.unlink();
+                    --_count[level];
+                    place(n);
+                }
+            }
+            if (((_cur >> shift(level)) & (level_size - 1)) != 0) break;
+        }
     }
 
-    void remove(const data &d) {
-        auto i = find(begin(_set), end(_set), d);
-        if (i != end(_set)) {
-            _set.erase(i);
+    template <class Function>
+    bool expire(link &head, const time_point &now, Function &f) {
+        bool fired = false;
+        for (link *l = head.next; l != &head;) {
+            node &n = static_cast<node &>(*l);
+            l = l->next;
+            if (n.when <= now) {
+                --_count[0];
+                n.unlink();
+                fired = true;
+                f(n.value, n.exception);
+            }
         }
+        return fired;
     }
 
-    void remove(const T &value) {
-        auto i = remove_if(begin(_set), end(_set),
-                [&value](const data &d) { return d.value == value; });
-        _set.erase(i, end(_set));
+    optional<time_point> compute_when() {
+        if (_count[0]) {
+            // exact: each root slot holds one millisecond
+            for (uint64_t i = 0; i < root_size; ++i) {
+                link &head = slot(0, _cur + i);
+                if (head.empty()) continue;
+                time_point w = static_cast<node &>(*head.next).when;
+                for (link *l = head.next; l != &head; l = l->next) {
+                    w = std::min(w, static_cast<node &>(*l).when);
+                }
+                _when = w;
+                break;
+            }
+        }
+        // lower bound: the start of the next occupied slot.
+        // tick will cascade it then and this becomes exact.
+        for (unsigned level = 1; level < nlevels; ++level) {
+            if (_count[level] == 0) continue;
+            const uint64_t base = _cur >> shift(level);
+            for (uint64_t i = 1; i <= level_size; ++i) {
+                if (slot(level, (base + i) << shift(level)).empty()) continue;
+                const time_point start = from_tick((base + i) << shift(level));
+                if (!_when || start < *_when) {
+                    _when = start;
+                }
+                break;
+            }
+        }
+        return _when;
     }
 
 public:
+    alarm_clock() {
+        for (auto &head : _root) head.make_head();
+        for (auto &level : _levels) {
+            for (auto &head : level) head.make_head();
+        }
+    }
+
+    // nodes point at the list heads
+    alarm_clock(const alarm_clock &) = delete;
+    alarm_clock &operator = (const alarm_clock &) = delete;
+
+    ~alarm_clock() {
+        // disarm anything still linked so scoped_alarm::cancel is a no-op
+        auto clear = [](link &head) {
+            while (!head.empty()) head.next->unlink();
+        };
+        for (auto &head : _root) clear(head);
+        for (auto &level : _levels) {
+            for (auto &head : level) clear(head);
+        }
+    }
+
+    //! call f(value, exception) for every alarm at or before now.
+    // f must not arm or cancel alarms in this clock
     template <class Function>
     void tick(const time_point &now, Function f) {
-        auto i = begin(_set);
-        for (; i != end(_set); ++i) {
-            if (i->when <= now) {
-                f(i->value, i->exception);
-            } else {
+        const uint64_t target = to_tick(now);
+        bool fired = false;
+        while (_cur < target) {
+            unsigned level = 0;
+            while (level < nlevels && _count[level] == 0) ++level;
+            if (level == nlevels) {
+                // empty, jump ahead
+                _cur = target;
                 break;
             }
+            if (level == 0) {
+                // everything in a past slot is due
+                fired |= expire(slot(0, _cur), now, f);
+                ++_cur;
+            } else {
+                // skip empty lower levels up to the next slot that can cascade
+                const uint64_t next = (_cur | ((uint64_t{1} << shift(level)) - 1)) + 1;
+                if (next > target) {
+                    _cur = target;
+                    break;
+                }
+                _cur = next;
+            }
+            if ((_cur & (root_size - 1)) == 0) {
+                cascade();
+            }
+        }
+        if (_count[0]) {
+            fired |= expire(slot(0, _cur), now, f);
+        }
+        if (_when && (fired || *_when <= now)) {
+            _when = nullopt;
         }
-        _set.erase(begin(_set), i);
     }
 
-    bool empty() const { return _set.empty(); }
+    bool empty() const { return total() == 0; }
 
-    optional<time_point> when() const {
-        if (_set.empty()) {
+    //! time of the next alarm, or an earlier time when the
+    //! next alarm is more than a few hundred milliseconds out
+    optional<time_point> when() {
+        if (total() == 0) {
             return nullopt;
         }
-        return _set.front().when;
+        if (_when) {
+            return _when;
+        }
+        return compute_when();
     }
 
 public:
     struct scoped_alarm {
 
         ptr<alarm_clock<T, Clock>> _set;
-        typename alarm_clock<T, Clock>::data _data;
+        typename alarm_clock<T, Clock>::node _node;
         bool _armed = false;
 
         scoped_alarm() {}
@@ -105,17 +306,14 @@ public:
         scoped_alarm(const scoped_alarm &) = delete;
         scoped_alarm &operator = (const scoped_alarm &) = delete;
 
-        scoped_alarm(scoped_alarm &&other) : _set{other._set} {
-            other._set.reset();
-            std::swap(_data, other._data);
-            std::swap(_armed, other._armed);
+        scoped_alarm(scoped_alarm &&other) {
+            take(other);
         }
 
         scoped_alarm &operator = (scoped_alarm &&other) {
             if (this != &other) {
-                std::swap(_set, other._set);
-                std::swap(_data, other._data);
-                std::swap(_armed, other._armed);
+                cancel();
+                take(other);
             }
             return *this;
         }
@@ -123,20 +321,30 @@ public:
         scoped_alarm(alarm_clock<T, Clock> &s, const T &value, time_point when)
             : _set(&s), _armed(true)
         {
-            _data = _set->insert(value, when);
+            _node.value = value;
+            _node.when = when;
+            _set->insert(_node);
         }
 
         template <class Exception>
             scoped_alarm(alarm_clock<T, Clock> &s, const T &value, time_point when, Exception e)
             : _set(&s), _armed(true)
             {
-                _data = _set->insert(value, when, e);
+                _node.value = value;
+                _node.when = when;
+                _node.exception = std::make_exception_ptr(e);
+                _set->insert(_node);
             }
 
+        //! the alarm went off and was taken out of the clock
+        bool fired() const {
+            return _armed && !_node.linked();
+        }
+
         duration remaining() const {
             if (_armed) {
                 const time_point now = Clock::now();
-                const duration rem = _data.when - now;
+                const duration rem = _node.when - now;
                 if (rem > duration::zero())
                     return rem;
             }
@@ -146,13 +354,28 @@ public:
         void cancel() {
             if (_armed) {
                 _armed = false;
-                _set->remove(_data);
+                _set->remove(_node);
             }
         }
 
         ~scoped_alarm() {
             cancel();
         }
+
+    private:
+        void take(scoped_alarm &other) {
+            _set = other._set;
+            _armed = other._armed;
+            _node.value = other._node.value;
+            _node.when = other._node.when;
+            _node.exception = std::move(other._node.exception);
+            _node.level = other._node.level;
+            if (other._node.linked()) {
+                _node.replace(other._node);
+            }
+            other._set.reset();
+            other._armed = false;
+        }
     };
 
 };
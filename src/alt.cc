@@ -0,0 +1,150 @@
+#include "ten/alt.hh"
+#include "scheduler.hh"
+#include "thread_context.hh"
+
+namespace ten {
+
+bool alt::try_case(size_t i) {
+    case_base &c = *_cases[i];
+    std::lock_guard<qutex> lk(c.lock());
+    if (!c.ready()) return false;
+    _closed = !c.complete();
+    return true;
+}
+
+bool alt::try_case(size_t i, bool &busy) {
+    case_base &c = *_cases[i];
+    std::unique_lock<qutex> lk(c.lock(), std::try_to_lock);
+    if (!lk.owns_lock()) {
+        busy = true;
+        return false;
+    }
+    if (!c.ready()) return false;
+    _closed = !c.complete();
+    return true;
+}
+
+int alt::poll() {
+    const size_t n = _cases.size();
+    for (size_t k = 0; k < n; ++k) {
+        const size_t i = (_next + k) % n;
+        if (try_case(i)) {
+            _next = i + 1;
+            return i;
+        }
+    }
+    return -1;
+}
+
+int alt::try_wait() {
+    DCHECK(!_cases.empty()) << "BUG: alt without cases";
+    return poll();
+}
+
+int alt::try_wait(bool &busy) {
+    DCHECK(!_cases.empty()) << "BUG: alt without cases";
+    busy = false;
+    const size_t n = _cases.size();
+    for (size_t k = 0; k < n; ++k) {
+        const size_t i = (_next + k) % n;
+        if (try_case(i, busy)) {
+            _next = i + 1;
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool alt::enqueue(rendez::alt_waiter &w) {
+    const size_t n = _cases.size();
+    for (size_t k = 0; k < n; ++k) {
+        case_base &c = *_cases[k];
+        std::unique_lock<qutex> lk(c.lock(), std::try_to_lock);
+        if (!lk.owns_lock() || c.ready()) {
+            if (lk.owns_lock()) lk.unlock();
+            // claimed by a case already queued means it is on its way
+            const bool claimed = !w.claim(n);
+            dequeue(w);
+            return claimed;
+        }
+        c.waitq().add(w, k);
+    }
+    return true;
+}
+
+void alt::dequeue(rendez::alt_waiter &w) {
+    for (auto &c : _cases) {
+        c->waitq().remove(w);
+    }
+}
+
+int alt::wait(optional_timeout ms) {
+    DCHECK(!_cases.empty()) << "BUG: alt without cases";
+    if (ms && ms->count() <= 0) return poll();
+    return wait_any(ms);
+}
+
+int alt::wait_any(optional_timeout ms) {
+    const auto t = scheduler::current_task();
+    const size_t n = _cases.size();
+    // wakes us without throwing like io::poll, so a deadline
+    // of the caller's still interrupts the wait
+    optional<scheduler::alarm_clock::scoped_alarm> timeout_alarm;
+    if (ms) {
+        timeout_alarm.emplace(this_ctx->scheduler.arm_alarm(t, kernel::now() + *ms));
+    }
+    for (;;) {
+        int i = poll();
+        if (i >= 0) return i;
+
+        rendez::alt_waiter w;
+        size_t queued = 0;
+        auto unqueue = [&] {
+            for (size_t k = 0; k < queued; ++k) {
+                _cases[k]->waitq().remove(w);
+            }
+        };
+        try {
+            for (; queued < n; ++queued) {
+                case_base &c = *_cases[queued];
+                std::lock_guard<qutex> lk(c.lock());
+                if (c.ready()) {
+                    if (w.claim(queued)) {
+                        _closed = !c.complete();
+                        unqueue();
+                        _next = queued + 1;
+                        return queued;
+                    }
+                    // another case fired meanwhile, go with that one
+                    break;
+                }
+                c.waitq().add(w, queued);
+            }
+            task::impl::cancellation_point cancellable;
+            while (w.fired.load() < 0) {
+                if (timeout_alarm && timeout_alarm->fired()) break;
+                t->swap();
+            }
+        } catch (...) {
+            unqueue();
+            if (!w.claim(n)) {
+                // woken and interrupted, wake someone else instead
+                _cases[w.fired.load()]->waitq().wakeup();
+            }
+            throw;
+        }
+        unqueue();
+        if (w.claim(n)) {
+            // the timeout won the race with every case
+            return -1;
+        }
+        i = w.fired.load();
+        if (try_case(i)) {
+            _next = i + 1;
+            return i;
+        }
+        // someone else got there first, start over
+    }
+}
+
+} // namespace
@@ -7,6 +7,16 @@ bool fdwait(int fd, int rw, optional_timeout ms) {
     return this_ctx->scheduler.get_io().fdwait(fd, rw, ms);
 }
 
+void fdregister(int fd) {
+    this_ctx->scheduler.get_io().register_edge(fd);
+}
+
+void fdunregister(int fd) {
+    // a thread without a scheduler has nothing registered
+    if (!this_ctx) return;
+    this_ctx->scheduler.get_io().unregister_edge(fd);
+}
+
 int taskpoll(pollfd *fds, nfds_t nfds, optional_timeout ms) {
     task::impl::cancellation_point cancellable;
     return this_ctx->scheduler.get_io().poll(fds, nfds, ms);
@@ -4,9 +4,8 @@ namespace ten {
 
 context::context() noexcept : _ctx{_os_ctx.get()} {}
 
-//! make a new context and stack
-context::context(func_type f, size_t stack_size) {
-    void *stack = stack_allocator::allocate(stack_size);
+//! make a new context on a stack owned by the caller
+context::context(func_type f, void *stack, size_t stack_size) {
 #ifndef NVALGRIND
     valgrind_stack_id =
         VALGRIND_STACK_REGISTER(stack, reinterpret_cast<intptr_t>(stack)-stack_size);
@@ -23,27 +22,29 @@ context::context(func_type f, size_t stack_size) {
 }
 
 context::~context() {
+    // the stack is freed by its owner, see task::impl::create
 #if BOOST_VERSION == 105100
     if (_ctx->fc_stack.base) {
-        void *stack = _ctx->fc_stack.base;
 #ifndef NVALGRIND
         VALGRIND_STACK_DEREGISTER(valgrind_stack_id);
 #endif
-        stack_allocator::deallocate(stack, stack_size());
         delete _ctx;
     }
 
 #elif BOOST_VERSION >= 105200
     if (_ctx->fc_stack.sp) {
-        void *stack = _ctx->fc_stack.sp;
 #ifndef NVALGRIND
         VALGRIND_STACK_DEREGISTER(valgrind_stack_id);
 #endif
-        stack_allocator::deallocate(stack, stack_size());
     }
 #endif
 }
 
+void context::reset(func_type f, void *stack, size_t stack_size) {
+    this->~context();
+    new (this) context(f, stack, stack_size);
+}
+
 intptr_t context::swap(context &other, intptr_t arg) noexcept {
     return ctx::jump_fcontext(_ctx,
             other._ctx,
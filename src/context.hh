@@ -39,8 +39,12 @@ public:
     //! make context for existing stack
     context() noexcept;
 
-    //! make a new context and stack
-    explicit context(func_type f, size_t stack_size);
+    //! make a new context on a stack owned by the caller
+    // stack is the high end, the stack grows down stack_size bytes
+    context(func_type f, void *stack, size_t stack_size);
+
+    //! start over running f on a new stack, used for recycled tasks
+    void reset(func_type f, void *stack, size_t stack_size);
 
     intptr_t swap(context &other, intptr_t arg=0) noexcept;
 
@@ -0,0 +1,234 @@
+#include "ten/task/coro.hh"
+#include "ten/alt.hh"
+#include "ten/thread_local.hh"
+#include "ten/task/compat.hh"
+#include "thread_context.hh"
+#include <deque>
+#include <map>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+namespace ten {
+namespace coro {
+namespace detail {
+
+namespace {
+
+//! per-thread task that resumes coroutines
+struct runner {
+    std::deque<waiter *> readyq;
+    //! waiters registered with io, unregistered if the runner exits early
+    std::unordered_set<waiter *> polling;
+    //! waiters queued in an alt, dequeued if the runner exits early
+    std::unordered_set<alt_waiter *> in_alt;
+    //! alt waiters claimed by a channel, possibly from another thread
+    std::mutex inbox_m;
+    std::vector<waiter *> inbox;
+    //! waiters with a deadline, keyed by (deadline, timer_id)
+    std::map<std::pair<kernel::time_point, uint64_t>, waiter *> timers;
+    uint64_t timer_seq = 0;
+    //! spawned coroutines that have not finished
+    size_t live = 0;
+    //! runner task has been spawned and not exited
+    bool running = false;
+    //! runner task, set once it starts
+    ptr<ten::task::impl> t;
+    //! runner task is swapped out waiting for work
+    bool sleeping = false;
+};
+
+struct runner_tag {};
+thread_cached<runner_tag, runner> this_runner;
+
+void fire_timers(runner &r) {
+    const auto now = kernel::now();
+    while (!r.timers.empty() && r.timers.begin()->first.first <= now) {
+        waiter *w = r.timers.begin()->second;
+        r.timers.erase(r.timers.begin());
+        w->timer_id = 0;
+        post(*w);
+    }
+}
+
+//! post the alt waiters claimed since the last pass
+void drain_inbox(runner &r) {
+    std::vector<waiter *> claimed;
+    {
+        std::lock_guard<std::mutex> lk(r.inbox_m);
+        claimed.swap(r.inbox);
+    }
+    for (waiter *w : claimed) {
+        post(*w);
+    }
+}
+
+void run(runner &r) {
+    const auto t = scheduler::current_task();
+    taskname("coro runner");
+    r.t = t;
+    struct exit_guard {
+        runner &r;
+        ~exit_guard() {
+            // canceled with coroutines still suspended, their frames stay
+            // but nothing may point into them once we are gone
+            auto &io = this_ctx->scheduler.get_io();
+            for (waiter *w : r.polling) {
+                io.remove_waiter(w->pfd);
+                w->registered = false;
+            }
+            r.polling.clear();
+            for (alt_waiter *w : r.in_alt) {
+                w->a->dequeue(*w);
+            }
+            r.in_alt.clear();
+            {
+                std::lock_guard<std::mutex> lk(r.inbox_m);
+                r.inbox.clear();
+            }
+            for (auto &timer : r.timers) {
+                timer.second->timer_id = 0;
+            }
+            r.timers.clear();
+            for (waiter *w : r.readyq) {
+                w->queued = false;
+            }
+            r.readyq.clear();
+            r.t = nullptr;
+            r.sleeping = false;
+            r.running = false;
+        }
+    } guard{r};
+    while (r.live > 0) {
+        fire_timers(r);
+        drain_inbox(r);
+        // only what is ready now, coroutines posted meanwhile
+        // wait for the next pass so tasks get a turn
+        for (size_t n = r.readyq.size(); n > 0; --n) {
+            waiter *w = r.readyq.front();
+            r.readyq.pop_front();
+            w->queued = false;
+            w->resume(w->handle);
+        }
+        if (!r.readyq.empty()) {
+            this_task::yield();
+            continue;
+        }
+        if (r.live == 0) break;
+        optional<scheduler::alarm_clock::scoped_alarm> timeout_alarm;
+        if (!r.timers.empty()) {
+            timeout_alarm.emplace(this_ctx->scheduler.arm_alarm(t, r.timers.begin()->first.first));
+        }
+        taskstate("waiting for %zu coroutines", r.live);
+        r.sleeping = true;
+        t->swap();
+        r.sleeping = false;
+    }
+}
+
+void io_ready(void *arg) {
+    post(*static_cast<waiter *>(arg));
+}
+
+//! called by the channel that claimed w, holding its rendez lock.
+// the rendez readies the runner task right after
+void alt_ready(rendez::alt_waiter &w) {
+    auto &aw = static_cast<alt_waiter &>(w);
+    runner &r = *static_cast<runner *>(aw.owner);
+    std::lock_guard<std::mutex> lk(r.inbox_m);
+    r.inbox.push_back(&aw.w);
+}
+
+} // anon
+
+void post(waiter &w) {
+    if (w.queued) return;
+    w.queued = true;
+    runner &r = *this_runner.get();
+    r.readyq.push_back(&w);
+    if (!r.running) {
+        r.running = true;
+        ten::task::spawn([] {
+            run(*this_runner.get());
+        });
+    } else if (r.sleeping) {
+        r.t->ready();
+    }
+}
+
+void arm(waiter &w, int fd, int rw, optional<kernel::time_point> deadline) {
+    DCHECK(this_ctx) << "BUG: coroutine outside of task";
+    if (fd >= 0) {
+        w.pfd.fd = fd;
+        w.pfd.events = (rw == 'r') ? EPOLLIN : EPOLLOUT;
+        w.pfd.revents = 0;
+        this_ctx->scheduler.get_io().add_waiter(w.pfd, &io_ready, &w);
+        this_runner.get()->polling.insert(&w);
+        w.registered = true;
+    }
+    if (deadline) {
+        runner &r = *this_runner.get();
+        w.deadline = *deadline;
+        w.timer_id = ++r.timer_seq;
+        // only called from a running coroutine, so the runner
+        // looks at timers again before it sleeps
+        r.timers.emplace(std::make_pair(w.deadline, w.timer_id), &w);
+    }
+}
+
+bool disarm(waiter &w) {
+    bool ready = false;
+    if (w.registered) {
+        this_ctx->scheduler.get_io().remove_waiter(w.pfd);
+        this_runner.get()->polling.erase(&w);
+        w.registered = false;
+        ready = w.pfd.revents && !(w.pfd.revents & (EPOLLERR | EPOLLHUP));
+    }
+    if (w.timer_id) {
+        this_runner.get()->timers.erase(std::make_pair(w.deadline, w.timer_id));
+        w.timer_id = 0;
+    }
+    return ready;
+}
+
+bool arm(alt_waiter &w, ten::alt &a) {
+    runner &r = *this_runner.get();
+    w.a = &a;
+    w.owner = &r;
+    w.wake = &alt_ready;
+    if (!a.enqueue(w)) return false;
+    r.in_alt.insert(&w);
+    return true;
+}
+
+void disarm(alt_waiter &w) {
+    w.a->dequeue(w);
+    this_runner.get()->in_alt.erase(&w);
+}
+
+bool on_runner() {
+    const runner &r = *this_runner.get();
+    return r.t && r.t == scheduler::current_task();
+}
+
+void started() {
+    ++this_runner.get()->live;
+}
+
+void finished(std::exception_ptr exception) {
+    --this_runner.get()->live;
+    if (!exception) return;
+    try {
+        std::rethrow_exception(exception);
+    } catch (backtrace_exception &e) {
+        LOG(ERROR) << "unhandled exception in coroutine: " << e.what() << "\n" << e.backtrace_str();
+    } catch (std::exception &e) {
+        LOG(ERROR) << "unhandled exception in coroutine: " << e.what();
+    } catch (...) {
+        LOG(ERROR) << "unhandled exception in coroutine";
+    }
+}
+
+} // detail
+} // coro
+} // ten
@@ -6,6 +6,9 @@ namespace ten {
 
 struct deadline_pimpl {
     scheduler::alarm_clock::scoped_alarm alarm;
+    ptr<task::impl> owner;
+    //! the task's deadline before this one, restored on cancel
+    kernel::time_point saved;
 };
 
 deadline::deadline(optional_timeout timeout) {
@@ -27,15 +30,26 @@ void deadline::_set_deadline(kernel::duration dur) {
         const auto t = scheduler::current_task();
         auto now = kernel::now();
         _pimpl.reset(new deadline_pimpl{
-                this_ctx->scheduler.arm_alarm(t, now + dur, deadline_reached{})
+                this_ctx->scheduler.arm_alarm(t, now + dur, deadline_reached{}),
+                t, t->_deadline
                 });
+        // for earliest deadline first scheduling
+        this_ctx->scheduler.reorder(*t, t->_priority, std::min(t->_deadline, now + dur));
         DVLOG(5) << "deadline alarm armed: " << _pimpl->alarm._armed << " in " << dur;
     }
 }
 
 void deadline::cancel() {
-    if (_pimpl) {
+    if (_pimpl && _pimpl->owner) {
         _pimpl->alarm.cancel();
+        // deadlines are scoped, so this undoes ours
+        auto &owner = *_pimpl->owner;
+        if (owner._scheduler) {
+            owner._scheduler->reorder(owner, owner._priority, _pimpl->saved);
+        } else {
+            owner._deadline = _pimpl->saved;
+        }
+        _pimpl->owner.reset();
     }
 }
 
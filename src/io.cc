@@ -1,5 +1,6 @@
 #include "io.hh"
 #include "thread_context.hh"
+#include "trace.hh"
 
 namespace ten {
 
@@ -39,7 +40,10 @@ io::io() {
 #endif // HAS_CARES
 }
 
-void io::add_pollfds(ptr<task::impl> t, pollfd *fds, nfds_t nfds) {
+int io::add_pollfds(ptr<task::impl> t, pollfd *fds, nfds_t nfds,
+        notify_fn notify, void *arg)
+{
+    int ready_fds = 0;
     for (nfds_t i=0; i<nfds; ++i) {
         epoll_event ev{};
         int fd = fds[i].fd;
@@ -51,23 +55,40 @@ void io::add_pollfds(ptr<task::impl> t, pollfd *fds, nfds_t nfds) {
         ev.data.fd = fd;
         uint32_t saved_events = _pollfds[fd].events;
 
-        _pollfds[fd].tasks.emplace_back(t, &fds[i]);
+        _pollfds[fd].tasks.emplace_back(t, &fds[i], notify, arg);
+
+        if (_pollfds[fd].edge) {
+            // already registered, but the edge may have come and gone
+            // while nobody was waiting
+            fds[i].revents = _pollfds[fd].ready & (fds[i].events | EPOLLERR | EPOLLHUP);
+            if (fds[i].revents) {
+                ++ready_fds;
+                ++_stats.edge_ready;
+            }
+            ++_npollfds;
+            continue;
+        }
+
         _pollfds[fd].events |= fds[i].events;
 
         ev.events = _pollfds[fd].events | EPOLLONESHOT;
 
         if (saved_events == 0) {
+            ++_stats.ctl;
             int status = _efd.modify(fd, ev);
             if (status == -1 && errno == ENOENT) {
+                ++_stats.ctl;
                 throw_if(_efd.add(fd, ev) == -1);
             } else {
                 throw_if(status == -1);
             }
         } else if (saved_events != _pollfds[fd].events) {
+            ++_stats.ctl;
             throw_if(_efd.modify(fd, ev) == -1);
         }
         ++_npollfds;
     }
+    return ready_fds;
 }
 
 int io::remove_pollfds(pollfd *fds, nfds_t nfds) {
@@ -88,15 +109,24 @@ int io::remove_pollfds(pollfd *fds, nfds_t nfds) {
             _pollfds[fd].events = events;
         }
 
-        if (fds[i].revents) {
+        if (_pollfds[fd].edge) {
+            // this waiter took the events it asked for,
+            // waiting again needs a new edge
+            _pollfds[fd].ready &= ~(fds[i].revents & fds[i].events);
+            if (fds[i].revents) {
+                ++evented_fds;
+            }
+        } else if (fds[i].revents) {
             ++evented_fds;
         } else {
             if (_pollfds[fd].events == 0) {
+                ++_stats.ctl;
                 _efd.remove(fd);
             } else if (saved_events != _pollfds[fd].events) {
                 epoll_event ev{};
                 ev.data.fd = fd;
                 ev.events = _pollfds[fd].events;
+                ++_stats.ctl;
                 throw_if(_efd.modify(fd, ev) == -1);
             }
         }
@@ -136,7 +166,12 @@ int io::poll(pollfd *fds, nfds_t nfds, optional_timeout ms) {
     } else {
         taskstate("poll %u fds for %ul ms", nfds, ms ? ms->count() : 0);
     }
-    add_pollfds(t, fds, nfds);
+    if (add_pollfds(t, fds, nfds) > 0) {
+        // events already seen on edge fds, no need to suspend
+        return remove_pollfds(fds, nfds);
+    }
+    trace::event(trace::event_type::io_wait, t->get_id(),
+            nfds == 1 ? uint64_t(fds->fd) : ~uint64_t{0});
 
     DVLOG(5) << "task: " << t << " poll for " << nfds << " fds";
     try {
@@ -154,35 +189,90 @@ int io::poll(pollfd *fds, nfds_t nfds, optional_timeout ms) {
     return remove_pollfds(fds, nfds);
 }
 
+void io::add_waiter(pollfd &pfd, notify_fn notify, void *arg) {
+    if (add_pollfds(nullptr, &pfd, 1, notify, arg) > 0) {
+        notify(arg);
+    }
+}
+
+int io::remove_waiter(pollfd &pfd) {
+    return remove_pollfds(&pfd, 1);
+}
+
+void io::register_edge(int fd) {
+    if (_pollfds.size() <= (size_t)fd) {
+        _pollfds.resize(fd+1);
+    }
+    auto &st = _pollfds[fd];
+    if (st.edge) return;
+    DCHECK(st.tasks.empty()) << "BUG: register_edge fd " << fd << " has waiters";
+    epoll_event ev{};
+    ev.data.fd = fd;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+    // fds waited on before stay in epoll after their oneshot fires
+    ++_stats.ctl;
+    int status = _efd.add(fd, ev);
+    if (status == -1 && errno == EEXIST) {
+        ++_stats.ctl;
+        throw_if(_efd.modify(fd, ev) == -1);
+    } else {
+        throw_if(status == -1);
+    }
+    st.edge = true;
+    // epoll reports what is ready now on the next wait
+    st.ready = 0;
+    st.events = 0;
+}
+
+void io::unregister_edge(int fd) {
+    if ((size_t)fd >= _pollfds.size() || !_pollfds[fd].edge) return;
+    auto &st = _pollfds[fd];
+    st.edge = false;
+    st.ready = 0;
+    st.events = 0;
+    ++_stats.ctl;
+    _efd.remove(fd);
+}
+
 void io::wakeup() {
     _evfd.write(1);
 }
 
+void io::arm_timer(kernel::time_point when) {
+    // an armed timer that fires early only costs an extra loop,
+    // so only re-arm when the deadline moves earlier (minus slack).
+    // an expired timer is still pending in epoll and clears _timer_armed
+    if (_timer_armed && *_timer_armed <= when + _timer_slack) return;
+    using namespace std::chrono;
+    // steady_clock is CLOCK_MONOTONIC, same as _tfd
+    const auto ns = duration_cast<nanoseconds>(when.time_since_epoch()).count();
+    struct itimerspec tspec{};
+    tspec.it_value.tv_sec = ns / 1000000000;
+    tspec.it_value.tv_nsec = ns % 1000000000;
+    if (tspec.it_value.tv_sec == 0 && tspec.it_value.tv_nsec == 0) {
+        // zero would disarm
+        tspec.it_value.tv_nsec = 1;
+    }
+    _tfd.settime(tspec, TFD_TIMER_ABSTIME);
+    _timer_armed = when;
+}
+
 void io::wait(optional<kernel::time_point> when) {
     // only process 100 events each iteration to keep it fair
     _events.resize(100);
     int ms = -1;
     if (when) {
-        using namespace std::chrono;
-        auto now = kernel::now();
-        if (*when > now) {
-            // TODO: allow more than millisecond resolution?
-            ms = duration_cast<milliseconds>((*when - now) + microseconds(999)).count();
-            if (ms) {
-                struct itimerspec tspec{};
-                tspec.it_value.tv_sec = ms / 1000;
-                tspec.it_value.tv_nsec = (ms % 1000) * 1000000;
-                _tfd.settime(tspec);
-                // we use timer_fd to break from epoll_wait
-                // because its timeout isn't very accurate
-                ms = -1;
-            }
+        if (*when > kernel::now()) {
+            // we use timer_fd to break from epoll_wait
+            // because its timeout isn't very accurate
+            arm_timer(*when);
         } else {
             // don't wait at all
             ms = 0;
         }
     }
 
+    ++_stats.wait;
     _efd.wait(_events, ms);
     ptr<task::impl> t;
     for (auto &event : _events) {
@@ -196,6 +286,7 @@ void io::wait(optional<kernel::time_point> when) {
             _evfd.read();
         } else if (fd == _tfd.fd) {
             // timerfd fired for sleeping/timeout tasks
+            _timer_armed = nullopt;
 #ifdef HAS_CARES
         } else if (fd == resolv_conf_watch_fd.fd) {
             inotify_event event;
@@ -206,17 +297,26 @@ void io::wait(optional<kernel::time_point> when) {
             this_ctx->dns_channel.reset();
 #endif // HAS_CARES
         } else if ((size_t)fd < _pollfds.size()) {
+            if (_pollfds[fd].edge) {
+                // kept until a waiter takes them, the next edge
+                // only comes with new data or buffer space
+                _pollfds[fd].ready |= event.events;
+            }
             for (auto &st : _pollfds[fd].tasks) {
                 if ((st.pfd->events & event.events) ||
                         event.events & (EPOLLERR | EPOLLHUP))
                 {
                     st.pfd->revents = event.events;
-                    DVLOG(5) << "fd " << fd << " EVENTS: " << event.events << " on task: " << st.t;
-                    st.t->ready_for_io();
+                    if (st.notify) {
+                        st.notify(st.arg);
+                    } else {
+                        DVLOG(5) << "fd " << fd << " EVENTS: " << event.events << " on task: " << st.t;
+                        st.t->ready_for_io();
+                    }
                 }
             }
 
-            if (_pollfds[fd].tasks.empty()) {
+            if (_pollfds[fd].tasks.empty() && !_pollfds[fd].edge) {
                 // TODO: otherwise we might want to remove fd from epoll
                 LOG(ERROR) << "event " << event.events << " for fd: "
                     << event.data.fd << " but has no task";
@@ -7,18 +7,29 @@
 namespace ten {
 
 class io {
+public:
+    //! called from wait() for a ready fd registered with add_waiter
+    typedef void (*notify_fn)(void *arg);
 private:
     struct task_poll_state {
         ptr<task::impl> t;
         pollfd *pfd;
+        //! set for waiters that are not tasks, called instead of readying t
+        notify_fn notify;
+        void *arg;
 
-        task_poll_state(ptr<task::impl> t_, pollfd *pfd_)
-            : t{t_}, pfd{pfd_} {}
+        task_poll_state(ptr<task::impl> t_, pollfd *pfd_,
+                notify_fn notify_=nullptr, void *arg_=nullptr)
+            : t{t_}, pfd{pfd_}, notify{notify_}, arg{arg_} {}
     };
 
     struct fd_poll_state {
         std::vector<task_poll_state> tasks;
         uint32_t events = 0; // events this fd is registered for
+        //! registered for its lifetime by register_edge
+        bool edge = false;
+        //! edge fds: events seen since a waiter last took them
+        uint32_t ready = 0;
     };
 
     typedef std::vector<fd_poll_state> fd_array;
@@ -37,17 +48,40 @@ private:
     epoll_fd _efd;
     //! number of fds we've been asked to wait on
     size_t _npollfds = 0;
+    //! deadline _tfd is armed for, cleared when it fires
+    optional<kernel::time_point> _timer_armed;
+    //! an armed deadline up to this much later than needed is kept
+    std::chrono::nanoseconds _timer_slack{0};
+    kernel::io_stats _stats;
 private:
-    void add_pollfds(ptr<task::impl> t, pollfd *fds, nfds_t nfds);
+    //! returns the number of edge fds that already have events
+    int add_pollfds(ptr<task::impl> t, pollfd *fds, nfds_t nfds,
+            notify_fn notify=nullptr, void *arg=nullptr);
     int remove_pollfds(pollfd *fds, nfds_t nfds);
+    void arm_timer(kernel::time_point when);
 public:
     io();
 
     bool fdwait(int fd, int rw, optional_timeout ms);
     int poll(pollfd *fds, nfds_t nfds, optional_timeout ms);
 
+    //! register pfd without blocking, notify(arg) is called when it is ready.
+    // pfd must stay put until remove_waiter
+    void add_waiter(pollfd &pfd, notify_fn notify, void *arg);
+    //! undo add_waiter, returns 1 if pfd got events
+    int remove_waiter(pollfd &pfd);
+
+    //! register fd for EPOLLIN|EPOLLOUT|EPOLLET until unregister_edge.
+    // waits on it then skip epoll_ctl, and only suspend when no event
+    // arrived since the last wait took it. must be undone before close
+    void register_edge(int fd);
+    void unregister_edge(int fd);
+
     void wakeup();
     void wait(optional<kernel::time_point> when);
+
+    void set_timer_slack(std::chrono::nanoseconds slack) { _timer_slack = slack; }
+    const kernel::io_stats &stats() const { return _stats; }
 };
 
 } // end namespace ten
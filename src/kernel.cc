@@ -1,5 +1,6 @@
 #include "thread_context.hh"
 #include <sys/syscall.h>
+#include <sys/prctl.h>
 
 namespace ten {
 
@@ -73,6 +74,39 @@ void kernel::boot() {
     std::call_once(boot_flag, kernel_boot);
 }
 
+void kernel::set_timer_slack(std::chrono::nanoseconds slack) {
+    // prctl treats 0 as reset to default, so ask for the 1ns minimum
+    throw_if(prctl(PR_SET_TIMERSLACK, std::max<long>(slack.count(), 1), 0, 0, 0) == -1);
+    this_ctx->scheduler.get_io().set_timer_slack(slack);
+}
+
+void kernel::set_busy_poll(std::chrono::microseconds max) {
+    this_ctx->scheduler.set_busy_poll(max);
+}
+
+kernel::ready_stats kernel::thread_ready_stats() {
+    return this_ctx->scheduler.ready_stats();
+}
+
+void kernel::set_deadline_scheduling(bool on) {
+    this_ctx->scheduler.set_edf(on);
+}
+
+kernel::io_stats kernel::thread_io_stats() {
+    return this_ctx->scheduler.io_stats();
+}
+
+kernel::stack_stats kernel::thread_stack_stats() {
+    return stack_allocator::thread_stats();
+}
+
+void kernel::set_stack_reclaim(size_t keep_bytes, unsigned sample_every) {
+    CHECK(sample_every > 0);
+    CHECK(keep_bytes >= stack_allocator::page_size) << "keep at least a page of stack";
+    stack_allocator::reclaim_keep = keep_bytes;
+    stack_allocator::reclaim_sample = sample_every;
+}
+
 void kernel::wait_for_tasks() {
     this_ctx->scheduler.wait_for_all();
 }
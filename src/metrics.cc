@@ -32,8 +32,35 @@ struct deduct_visitor : boost::static_visitor<> {
         }
 };
 
+struct sched_tag {};
+thread_cached<sched_tag, kernel::ready_stats> last_sched;
+
 } // anon namespace
 
+void record_scheduler() {
+    using namespace std::chrono;
+    static const char *classes[] = { "critical", "normal", "background" };
+    const auto cur = kernel::thread_ready_stats();
+    auto &last = *last_sched.get();
+    auto g = record();
+    g.timer("ten", "sched", "run_time").update(
+            duration_cast<timer::clock_type::duration>(cur.run_time - last.run_time));
+    for (size_t c = 0; c < kernel::ready_stats::nclasses; ++c) {
+        g.counter("ten", "sched", "runs", classes[c]).incr(cur.runs[c] - last.runs[c]);
+        g.counter("ten", "sched", "starved", classes[c]).incr(cur.starved[c] - last.starved[c]);
+    }
+    for (size_t i = 0; i < kernel::ready_stats::nwait; ++i) {
+        const auto n = cur.wait[i] - last.wait[i];
+        if (n == 0) continue;
+        if (i + 1 < kernel::ready_stats::nwait) {
+            g.counter("ten", "sched", "wait", "le_" + std::to_string(1u << i) + "us").incr(n);
+        } else {
+            g.counter("ten", "sched", "wait", "more").incr(n);
+        }
+    }
+    last = cur;
+}
+
 void merge_to(group_map &to, const group_map &from) {
     for (const auto &fkv : from) {
         // try to insert into merged map
@@ -72,8 +99,10 @@ intervals::~intervals() {
 void intervals::_collector_main() {
     using namespace std::chrono;
     const auto depth = _depth;
+    this_task::set_priority(task_priority::background);
     for (;;) {
         this_task::sleep_for(_interval);
+        record_scheduler();
         auto ag = global.aggregate();
         const time_t now = ::time(nullptr);
         _queue([&ag, now, depth](queue_type &q) mutable {
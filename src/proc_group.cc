@@ -0,0 +1,291 @@
+#include "proc_group_impl.hh"
+#include "thread_context.hh"
+#include "ten/task/compat.hh"
+#include <limits>
+
+namespace ten {
+
+namespace {
+
+void attach_here(task::impl *t) {
+    DCHECK(this_ctx) << "BUG: spawn called outside of task";
+    this_ctx->scheduler.attach_task(t->unpark());
+    // add new tasks to front of runqueue, same as task::spawn
+    t->ready(true);
+}
+
+} // anon namespace
+
+proc_group::impl::impl(size_t nthreads) {
+    CHECK(nthreads > 0) << "proc_group needs at least one thread";
+    for (size_t i=0; i<nthreads; ++i) {
+        slots.emplace_back(new slot);
+    }
+    for (size_t i=0; i<nthreads; ++i) {
+        threads.emplace_back(task::spawn_thread([this, i] {
+            taskname("proc_group[%zu]", i);
+            this_ctx->scheduler.join_group(this, i);
+            // leave even if this task is canceled
+            struct leave_guard {
+                ~leave_guard() { this_ctx->scheduler.leave_group(); }
+            } guard;
+            try {
+                taskstate("running");
+                stop.recv();
+            } catch (channel_closed_error &e) {
+            }
+            taskstate("stopping");
+        }));
+    }
+}
+
+proc_group::impl::~impl() {
+    // only non-empty if the group threads were canceled
+    // before the group was destroyed
+    task::impl *t = nullptr;
+    while (inject.pop(t)) {
+        t->unpark();
+    }
+    for (auto &s : slots) {
+        while (optional<task::impl *> tt = s->work.take()) {
+            (*tt)->unpark();
+        }
+        while (s->pinned.pop(t)) {
+            t->unpark();
+        }
+    }
+}
+
+void proc_group::impl::join(size_t self, ptr<scheduler> sched) {
+    std::lock_guard<std::mutex> lock{mutex};
+    DCHECK(!slots[self]->sched);
+    slots[self]->sched = sched;
+}
+
+std::vector<task::impl *> proc_group::impl::leave(size_t self) {
+    std::vector<task::impl *> left;
+    std::lock_guard<std::mutex> lock{mutex};
+    set_idle(self, false);
+    slots[self]->sched = nullptr;
+    slots[self]->left = true;
+    while (optional<task::impl *> t = slots[self]->work.take()) {
+        left.push_back(*t);
+    }
+    // push_pinned checks left under the lock
+    task::impl *p = nullptr;
+    while (slots[self]->pinned.pop(p)) {
+        --slots[self]->npinned;
+        left.push_back(p);
+    }
+    if (stopping) {
+        // push_inject checks stopping under the lock
+        // so nothing can be injected after this
+        task::impl *t = nullptr;
+        while (inject.pop(t)) {
+            left.push_back(t);
+        }
+    }
+    return left;
+}
+
+task::impl *proc_group::impl::find_work(size_t self) {
+    if (optional<task::impl *> t = slots[self]->work.take()) {
+        return *t;
+    }
+    task::impl *t = nullptr;
+    if (inject.pop(t)) {
+        return t;
+    }
+    // start with the next slot so thieves spread out
+    const size_t n = slots.size();
+    for (size_t i=1; i<n; ++i) {
+        auto &victim = slots[(self + i) % n]->work;
+        // steal can fail because of a race with the owner or
+        // another thief, retry a few times before moving on
+        for (int tries=0; tries<4; ++tries) {
+            auto r = victim.steal();
+            if (r.second) {
+                DVLOG(5) << "proc_group " << self << " stole from " << (self + i) % n;
+                return *r.second;
+            }
+            if (r.first) break; // empty
+        }
+    }
+    return nullptr;
+}
+
+task::impl *proc_group::impl::take_pinned(size_t self) {
+    task::impl *t = nullptr;
+    if (slots[self]->pinned.pop(t)) {
+        --slots[self]->npinned;
+        return t;
+    }
+    return nullptr;
+}
+
+bool proc_group::impl::has_work(size_t self) {
+    if (!inject.empty()) return true;
+    if (!slots[self]->pinned.empty()) return true;
+    // only this thread pushes to its own deque, and it drained
+    // it with find_work before looking here
+    const size_t n = slots.size();
+    for (size_t i=1; i<n; ++i) {
+        if (!slots[(self + i) % n]->work.empty()) return true;
+    }
+    return false;
+}
+
+void proc_group::impl::set_idle(size_t self, bool idle) {
+    if (slots[self]->idle.exchange(idle) != idle) {
+        if (idle) {
+            ++nidle;
+        } else {
+            --nidle;
+        }
+    }
+}
+
+void proc_group::impl::notify_idle() {
+    // seq_cst pairs with set_idle followed by has_work in scheduler::wait
+    // so either we see the idle scheduler or it sees the new work
+    if (nidle.load() == 0) return;
+    std::lock_guard<std::mutex> lock{mutex};
+    for (auto &s : slots) {
+        if (s->sched && s->idle.load()) {
+            s->sched->wakeup();
+            return;
+        }
+    }
+}
+
+void proc_group::impl::push(size_t self, task::impl *t) {
+    slots[self]->work.push(t);
+    notify_idle();
+}
+
+void proc_group::impl::push_inject(task::impl *t) {
+    bool queued;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        queued = !stopping;
+        if (queued) {
+            inject.push(t);
+        }
+    }
+    if (queued) {
+        notify_idle();
+    } else {
+        // group is going away, run it here instead
+        attach_here(t);
+    }
+}
+
+void proc_group::impl::push_pinned(size_t i, task::impl *t) {
+    bool queued;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        slot &s = *slots[i];
+        queued = !stopping && !s.left;
+        if (queued) {
+            ++s.npinned;
+            s.pinned.push(t);
+            // not joined yet is fine, it is picked up after joining
+            if (s.sched) {
+                s.sched->wakeup();
+            }
+        }
+    }
+    if (!queued) {
+        // thread is gone, run it here instead
+        attach_here(t);
+    }
+}
+
+size_t proc_group::impl::least_loaded() {
+    // rotate the starting slot so ties spread out
+    const size_t n = slots.size();
+    const size_t start = balance_next.fetch_add(1, std::memory_order_relaxed) % n;
+    size_t best = start;
+    size_t best_load = std::numeric_limits<size_t>::max();
+    for (size_t k=0; k<n; ++k) {
+        const size_t i = (start + k) % n;
+        const slot &s = *slots[i];
+        const size_t load = s.depth.load(std::memory_order_relaxed)
+            + s.npinned.load(std::memory_order_relaxed);
+        if (load < best_load) {
+            best = i;
+            best_load = load;
+            if (load == 0) break;
+        }
+    }
+    return best;
+}
+
+void proc_group::impl::run(const std::function<void ()> &f) {
+    struct finished {
+        proc_group::impl *g;
+        ~finished() {
+            if (--g->active == 0) {
+                std::lock_guard<qutex> lock{g->done_mutex};
+                g->done.wakeupall();
+            }
+        }
+    } fin{this};
+    f();
+}
+
+proc_group::proc_group(size_t nthreads)
+    : _impl{new impl{nthreads}}
+{
+}
+
+proc_group::~proc_group() {
+    DCHECK(!this_ctx || this_ctx->scheduler.group().get() != _impl.get())
+        << "BUG: proc_group destroyed from one of its own threads";
+    try {
+        // wait for group tasks, and tasks they spawn, to finish
+        std::unique_lock<qutex> lock{_impl->done_mutex};
+        _impl->done.sleep(lock, [this] { return _impl->active == 0; });
+    } catch (task_interrupted &e) {
+        // canceled, stop the threads anyway
+    }
+    {
+        std::lock_guard<std::mutex> lock{_impl->mutex};
+        _impl->stopping = true;
+    }
+    _impl->stop.close();
+    // joins the threads, they finish anything spawned since
+    _impl->threads.clear();
+}
+
+void proc_group::spawn_on_fn(size_t i, std::function<void ()> f) {
+    CHECK(i < size()) << "proc_group thread index " << i << " out of range";
+    ++_impl->active;
+    task::impl *t = task::impl::park(task::impl::create(
+        std::bind(&impl::run, _impl.get(), std::move(f)),
+        stack_allocator::default_stacksize));
+    _impl->push_pinned(i, t);
+}
+
+size_t proc_group::least_loaded() const {
+    return _impl->least_loaded();
+}
+
+size_t proc_group::size() const {
+    return _impl->slots.size();
+}
+
+void proc_group::spawn_fn(std::function<void ()> f) {
+    ++_impl->active;
+    // the deques hold raw pointers, the task keeps itself alive until attached
+    task::impl *t = task::impl::park(task::impl::create(
+        std::bind(&impl::run, _impl.get(), std::move(f)),
+        stack_allocator::default_stacksize));
+    if (this_ctx && this_ctx->scheduler.group().get() == _impl.get()) {
+        _impl->push(this_ctx->scheduler.group_slot(), t);
+    } else {
+        _impl->push_inject(t);
+    }
+}
+
+} // ten
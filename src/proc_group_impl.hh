@@ -0,0 +1,89 @@
+#ifndef LIBTEN_PROC_GROUP_IMPL_HH
+#define LIBTEN_PROC_GROUP_IMPL_HH
+
+#include "ten/task/proc_group.hh"
+#include "ten/work_deque.hh"
+#include "ten/llqueue.hh"
+#include "ten/channel.hh"
+#include "ten/thread_guard.hh"
+#include "ten/task/qutex.hh"
+#include "ten/task/rendez.hh"
+#include "task_impl.hh"
+#include <vector>
+#include <mutex>
+
+namespace ten {
+
+class proc_group::impl {
+public:
+    struct slot {
+        //! unstarted tasks spawned by this thread, stolen from the front
+        work_deque<task::impl *> work{64};
+        //! unstarted tasks that must run on this thread, never stolen
+        llqueue<task::impl *> pinned;
+        //! tasks in pinned not yet taken by the scheduler
+        std::atomic<size_t> npinned{0};
+        //! ready queue depth, published by the scheduler each iteration
+        std::atomic<size_t> depth{0};
+        //! set once the scheduler left, pinned tasks then run elsewhere
+        // protected by impl::mutex
+        bool left = false;
+        //! scheduler of the thread, null until joined and after leaving
+        // protected by impl::mutex
+        ptr<scheduler> sched;
+        //! true while the scheduler is about to sleep or sleeping
+        std::atomic<bool> idle{false};
+    };
+
+    std::vector<std::unique_ptr<slot>> slots;
+    //! tasks spawned from threads outside the group
+    llqueue<task::impl *> inject;
+    //! number of slots with idle set
+    std::atomic<size_t> nidle{0};
+    //! where least_loaded starts looking
+    std::atomic<size_t> balance_next{0};
+    //! tasks spawned into the group that have not finished
+    std::atomic<size_t> active{0};
+    //! used to wait for active to reach zero
+    qutex done_mutex;
+    rendez done;
+    //! set when the group is being destroyed
+    std::atomic<bool> stopping{false};
+    //! protects slot::sched
+    std::mutex mutex;
+    //! closed to tell group threads to exit
+    channel<int> stop;
+    std::vector<thread_guard> threads;
+
+    explicit impl(size_t nthreads);
+    ~impl();
+
+    void join(size_t self, ptr<scheduler> sched);
+    //! returns unstarted tasks left in this slot
+    std::vector<task::impl *> leave(size_t self);
+
+    //! own deque first, then injected tasks, then steal from others
+    task::impl *find_work(size_t self);
+    //! next task pinned to this slot, or null
+    task::impl *take_pinned(size_t self);
+    //! is there anything find_work might return, besides our own
+    // deque, which find_work has already drained
+    bool has_work(size_t self);
+
+    void set_idle(size_t self, bool idle);
+    //! wake one idle scheduler, if any
+    void notify_idle();
+
+    void push(size_t self, task::impl *t);
+    void push_inject(task::impl *t);
+    void push_pinned(size_t i, task::impl *t);
+    //! slot with the fewest ready and pinned tasks
+    size_t least_loaded();
+
+    //! entry point of group tasks, tracks active
+    void run(const std::function<void ()> &f);
+};
+
+} // ten
+
+#endif // LIBTEN_PROC_GROUP_IMPL_HH
@@ -1,21 +1,51 @@
 #include "ten/task/qutex.hh"
+#include "ten/task/coro.hh"
 #include "scheduler.hh"
 
 namespace ten {
 
+namespace {
+inline uintptr_t word(ptr<task::impl> t) {
+    return reinterpret_cast<uintptr_t>(t.get());
+}
+}
+
 void qutex::lock(lock_type_t lt) {
     const auto t = scheduler::current_task();
-    DCHECK(!t->cancelable()) << "BUG: cannot cancel a lock";
     DCHECK(t) << "BUG: qutex::lock called outside of task";
+    DCHECK(!t->cancelable()) << "BUG: cannot cancel a lock";
+    uintptr_t unlocked = 0;
+    if (_state.compare_exchange_strong(unlocked, word(t), std::memory_order_acquire)) {
+        DVLOG(5) << "LOCK qutex: " << this << " owner: " << t;
+        return;
+    }
+    lock_slow(t, lt);
+}
+
+void qutex::lock_slow(ptr<task::impl> t, lock_type_t lt) {
     {
         std::lock_guard<std::mutex> lk{_m};
-        DCHECK(_owner != t) << "no recursive locking: " << t;
-        if (_owner == nullptr) {
-            _owner = t;
-            DVLOG(5) << "LOCK qutex: " << this << " owner: " << _owner;
-            return;
+        uintptr_t s = _state.load(std::memory_order_relaxed);
+        for (;;) {
+            DCHECK((s & ~waiters) != word(t)) << "no recursive locking: " << t;
+            if (s == 0) {
+                // released before we got here. zero means
+                // nobody is waiting, since that needs the bit
+                if (_state.compare_exchange_weak(s, word(t), std::memory_order_acquire)) {
+                    DVLOG(5) << "LOCK qutex: " << this << " owner: " << t;
+                    return;
+                }
+            } else if ((s & waiters) ||
+                    _state.compare_exchange_weak(s, s | waiters, std::memory_order_relaxed)) {
+                // the owner can no longer unlock without taking _m
+                break;
+            }
+        }
+        if (coro::detail::on_runner()) {
+            // would stall every coroutine on the thread
+            throw errorx("qutex contended in a coroutine");
         }
-        DVLOG(5) << "QUTEX[" << this << "] lock waiting add: " << t <<  " owner: " << _owner;
+        DVLOG(5) << "QUTEX[" << this << "] lock waiting add: " << t;
         _waiting.push_back(t);
     }
 
@@ -31,8 +61,8 @@ void qutex::lock(lock_type_t lt) {
                 default:
                     t->swap();
             }
-            std::lock_guard<std::mutex> lk{_m};
-            if (_owner == t) {
+            // unlock hands the lock over before readying us
+            if ((_state.load(std::memory_order_acquire) & ~waiters) == word(t)) {
                 break;
             }
         }
@@ -47,26 +77,23 @@ void qutex::lock(lock_type_t lt) {
 bool qutex::try_lock() {
     const auto t = scheduler::current_task();
     DCHECK(t) << "BUG: qutex::try_lock called outside of task";
-    std::unique_lock<std::mutex> lk{_m, std::try_to_lock};
-    if (lk.owns_lock()) {
-        if (_owner == nullptr) {
-            _owner = t;
-            return true;
-        }
-    }
-    return false;
+    uintptr_t unlocked = 0;
+    return _state.compare_exchange_strong(unlocked, word(t), std::memory_order_acquire);
 }
 
 void qutex::unlock_or_giveup(std::lock_guard<std::mutex> &lk) noexcept {
     const auto current_task = scheduler::current_task();
     DVLOG(5) << "QUTEX[" << this << "] unlock: " << current_task;
-    if (current_task == _owner) {
+    const uintptr_t s = _state.load(std::memory_order_relaxed);
+    if ((s & ~waiters) == word(current_task)) {
+        // nobody else changes a locked word while we hold _m
         ptr<task::impl> new_owner;
         if (!_waiting.empty()) {
             new_owner = _waiting.front();
             _waiting.pop_front();
         }
-        _owner = new_owner;
+        _state.store(new_owner ? (word(new_owner) | (_waiting.empty() ? 0 : waiters)) : 0,
+                std::memory_order_release);
         DVLOG(5) << "UNLOCK qutex: " << this
             << " new owner: " << new_owner
             << " waiting: " << _waiting.size();
@@ -82,9 +109,19 @@ void qutex::unlock_or_giveup(std::lock_guard<std::mutex> &lk) noexcept {
     }
 }
 
-void qutex::unlock() {
+void qutex::unlock_slow() noexcept {
     std::lock_guard<std::mutex> lk{_m};
     unlock_or_giveup(lk);
 }
 
+void qutex::unlock() {
+    const auto t = scheduler::current_task();
+    uintptr_t owned = word(t);
+    if (_state.compare_exchange_strong(owned, 0, std::memory_order_release)) {
+        DVLOG(5) << "UNLOCK qutex: " << this;
+        return;
+    }
+    unlock_slow();
+}
+
 } // namespace
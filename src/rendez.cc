@@ -1,19 +1,43 @@
 #include "ten/task/rendez.hh"
+#include "ten/task/coro.hh"
 #include "scheduler.hh"
+#include "thread_context.hh"
 #include <mutex>
 
 namespace ten {
 
+rendez::alt_waiter::alt_waiter()
+    : t{scheduler::current_task()}, fired{-1}
+{
+}
+
 void rendez::sleep(std::unique_lock<qutex> &lk) {
+    sleep_impl(lk, nullptr, nullopt);
+}
+
+void rendez::sleep_until(std::unique_lock<qutex> &lk, kernel::time_point when) {
+    sleep_impl(lk, nullptr, when);
+}
+
+void rendez::sleep_handoff(std::unique_lock<qutex> &lk, void *slot) {
+    sleep_impl(lk, slot, nullopt);
+}
+
+void rendez::sleep_impl(std::unique_lock<qutex> &lk, void *slot, optional<kernel::time_point> until) {
     DCHECK(lk.owns_lock()) << "must own lock before calling rendez::sleep";
     const auto t = scheduler::current_task();
+    if (coro::detail::on_runner()) {
+        // would stall every coroutine on the thread, see coro::recv
+        throw errorx("rendez::sleep in a coroutine");
+    }
 
     {
         std::lock_guard<std::mutex> ll(_m);
-        DCHECK(std::find(_waiting.begin(), _waiting.end(), t) == _waiting.end())
+        DCHECK(std::find_if(_waiting.begin(), _waiting.end(),
+                    [t](const waiter &w) { return w.t == t && !w.alt; }) == _waiting.end())
             << "BUG: " << t << " already waiting on rendez " << this;
         DVLOG(5) << "RENDEZ[" << this << "] PUSH BACK: " << t;
-        _waiting.push_back(t);
+        _waiting.push_back(waiter{t, nullptr, 0, slot});
     }
     // must hold the lock until we're in the waiting list
     // otherwise another thread might modify the condition and
@@ -22,24 +46,37 @@ void rendez::sleep(std::unique_lock<qutex> &lk) {
     try
     {
         {
+            optional<scheduler::alarm_clock::scoped_alarm> timeout_alarm;
+            if (until) {
+                timeout_alarm.emplace(this_ctx->scheduler.arm_alarm(t, *until));
+            }
             task::impl::cancellation_point cancellable;
             t->swap();
         }
+        if (until) {
+            // still queued means the alarm woke us, not a wakeup
+            std::lock_guard<std::mutex> ll(_m);
+            auto i = std::find_if(_waiting.begin(), _waiting.end(),
+                    [t](const waiter &w) { return w.t == t && !w.alt; });
+            if (i != _waiting.end()) {
+                _waiting.erase(i);
+            }
+        }
         lk.lock();
     } catch (...) {
         ptr<task::impl> wake_task = nullptr;
         {
             std::lock_guard<std::mutex> ll(_m);
-            auto i = std::find(_waiting.begin(), _waiting.end(), t);
+            auto i = std::find_if(_waiting.begin(), _waiting.end(),
+                    [t](const waiter &w) { return w.t == t && !w.alt; });
             if (i != _waiting.end()) {
                 _waiting.erase(i);
-            } else if (!_waiting.empty()) {
+            } else {
                 // this handles the case where the task was woken up
                 // by the rendez *and* canceled or deadlined.
                 // so it needs to wake up another task instead of itself
                 // before it dies otherwise we could deadlock
-                wake_task = _waiting.front();
-                _waiting.pop_front();
+                wake_task = take_one();
             }
         }
         if (wake_task) {
@@ -50,14 +87,33 @@ void rendez::sleep(std::unique_lock<qutex> &lk) {
     }
 }
 
+namespace {
+//! claim an alt for index, holding the rendez lock
+bool claim(rendez::alt_waiter *alt, int index) {
+    // an alt claimed by another rendez is as good as gone
+    if (!alt) return true;
+    if (!alt->claim(index)) return false;
+    if (alt->wake) alt->wake(*alt);
+    return true;
+}
+}
+
+ptr<task::impl> rendez::take_one() {
+    while (!_waiting.empty()) {
+        const waiter w = _waiting.front();
+        _waiting.pop_front();
+        if (claim(w.alt, w.index)) {
+            return w.t;
+        }
+    }
+    return nullptr;
+}
+
 void rendez::wakeup() {
     ptr<task::impl> t = nullptr;
     {
         std::lock_guard<std::mutex> lk(_m);
-        if (!_waiting.empty()) {
-            t = _waiting.front();
-            _waiting.pop_front();
-        }
+        t = take_one();
     }
 
     DVLOG(5) << "RENDEZ[" << this << "] " << scheduler::current_task() << " wakeup: " << t;
@@ -65,22 +121,59 @@ void rendez::wakeup() {
 }
 
 void rendez::wakeupall() {
-    std::deque<ptr<task::impl>> waiting;
+    std::deque<ptr<task::impl>> tasks;
     {
         std::lock_guard<std::mutex> lk(_m);
-        std::swap(waiting, _waiting);
+        // claim alts holding _m, rendez::remove must not
+        // return while we can still touch one
+        for (const waiter &w : _waiting) {
+            if (claim(w.alt, w.index)) {
+                tasks.push_back(w.t);
+            }
+        }
+        _waiting.clear();
     }
 
-    for (auto t : waiting) {
+    for (auto t : tasks) {
         DVLOG(5) << "RENDEZ[" << this << "] " << scheduler::current_task() << " wakeupall: " << t;
         t->ready();
     }
 }
 
+bool rendez::handoff(void (*fill)(void *slot, void *arg), void *arg) {
+    ptr<task::impl> t = nullptr;
+    {
+        std::lock_guard<std::mutex> lk(_m);
+        auto i = std::find_if(_waiting.begin(), _waiting.end(),
+                [](const waiter &w) { return w.slot != nullptr; });
+        if (i == _waiting.end()) return false;
+        // filled holding _m, so a sleeper interrupted meanwhile
+        // sees the value once it finds itself gone from _waiting
+        fill(i->slot, arg);
+        t = i->t;
+        _waiting.erase(i);
+    }
+    DVLOG(5) << "RENDEZ[" << this << "] " << scheduler::current_task() << " handoff: " << t;
+    // like runnext in go, the receiver runs as soon as we block
+    t->ready(true);
+    return true;
+}
+
+void rendez::add(alt_waiter &w, int index) {
+    std::lock_guard<std::mutex> lk(_m);
+    _waiting.push_back(waiter{w.t, &w, index, nullptr});
+}
+
+void rendez::remove(alt_waiter &w) {
+    std::lock_guard<std::mutex> lk(_m);
+    _waiting.erase(std::remove_if(_waiting.begin(), _waiting.end(),
+                [&w](const waiter &i) { return i.alt == &w; }),
+            _waiting.end());
+}
+
 rendez::~rendez() {
-    using ::operator<<;
     std::lock_guard<std::mutex> lk(_m);
-    DCHECK(_waiting.empty()) << "BUG: still waiting: " << _waiting;
+    DCHECK(_waiting.empty()) << "BUG: still waiting: " << _waiting.size() << " tasks";
 }
 
 } // namespace
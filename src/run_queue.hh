@@ -0,0 +1,173 @@
+#ifndef LIBTEN_RUN_QUEUE_HH
+#define LIBTEN_RUN_QUEUE_HH
+
+#include "task_impl.hh"
+#include <boost/intrusive/set.hpp>
+
+namespace ten {
+
+//! ready tasks, one queue per task_priority.
+//
+//! higher classes run first. a lower class that has been passed over
+//! starve_limit times in a row gets the next turn, so background work
+//! still makes progress under load. with edf on, tasks holding a
+//! deadline run before the rest of their class, earliest deadline first,
+//! but the head of the class's fifo gets every starve_limit'th turn.
+//! a task's priority and deadline must not change while it is queued,
+//! see scheduler::reorder.
+class run_queue {
+public:
+    typedef kernel::ready_stats stats;
+    static constexpr size_t nclasses = stats::nclasses;
+    static constexpr unsigned starve_limit = 32;
+
+private:
+    typedef boost::intrusive::list<task::impl,
+            boost::intrusive::member_hook<task::impl,
+                boost::intrusive::list_member_hook<>,
+                &task::impl::_ready_hook>> fifo_queue;
+
+    struct deadline_less {
+        bool operator()(const task::impl &a, const task::impl &b) const {
+            return a._deadline < b._deadline;
+        }
+    };
+    typedef boost::intrusive::multiset<task::impl,
+            boost::intrusive::member_hook<task::impl,
+                boost::intrusive::set_member_hook<>,
+                &task::impl::_edf_hook>,
+            boost::intrusive::compare<deadline_less>> edf_queue;
+
+    fifo_queue _fifo[nclasses];
+    edf_queue _edf[nclasses];
+    //! times each class was passed over while it had ready tasks
+    unsigned _passed[nclasses] = {};
+    //! deadline tasks run in a row while the class fifo waited
+    unsigned _fifo_passed[nclasses] = {};
+    bool _use_edf = false;
+    stats _stats;
+
+    static size_t class_of(const task::impl &t) {
+        return static_cast<size_t>(t._priority);
+    }
+
+    size_t size(size_t c) const { return _fifo[c].size() + _edf[c].size(); }
+
+    bool by_deadline(const task::impl &t) const {
+        return _use_edf && t._deadline != kernel::time_point::max();
+    }
+
+    void pushed(size_t c) {
+        const size_t d = size(c);
+        if (d > _stats.max_depth[c]) _stats.max_depth[c] = d;
+    }
+
+    //! class to run next, highest ready class unless another is starving
+    size_t pick() {
+        size_t best = nclasses;
+        for (size_t c = 0; c < nclasses; ++c) {
+            if (size(c) == 0) continue;
+            if (best == nclasses) {
+                best = c;
+            } else if (++_passed[c] >= starve_limit) {
+                ++_stats.starved[c];
+                best = c;
+                break;
+            }
+        }
+        DCHECK(best < nclasses);
+        _passed[best] = 0;
+        return best;
+    }
+
+public:
+    run_queue() {}
+    run_queue(const run_queue &) = delete;
+    run_queue &operator = (const run_queue &) = delete;
+
+    //! order tasks holding a deadline by it, only affects tasks readied later
+    void set_edf(bool on) { _use_edf = on; }
+
+    bool empty() const {
+        for (size_t c = 0; c < nclasses; ++c) {
+            if (size(c)) return false;
+        }
+        return true;
+    }
+
+    //! number of ready tasks in all classes
+    size_t size() const {
+        size_t n = 0;
+        for (size_t c = 0; c < nclasses; ++c) {
+            n += size(c);
+        }
+        return n;
+    }
+
+    //! is t in the queue
+    static bool linked(const task::impl &t) {
+        return t._ready_hook.is_linked() || t._edf_hook.is_linked();
+    }
+
+    void push_back(task::impl &t) {
+        const size_t c = class_of(t);
+        t._ready_class = c;
+        if (by_deadline(t)) {
+            _edf[c].insert(t);
+        } else {
+            _fifo[c].push_back(t);
+        }
+        pushed(c);
+    }
+
+    //! front of its class, or in deadline order
+    void push_front(task::impl &t) {
+        const size_t c = class_of(t);
+        t._ready_class = c;
+        if (by_deadline(t)) {
+            _edf[c].insert(t);
+        } else {
+            _fifo[c].push_front(t);
+        }
+        pushed(c);
+    }
+
+    //! remove and return the next task to run, must not be empty
+    task::impl &pop() {
+        const size_t c = pick();
+        ++_stats.runs[c];
+        if (!_edf[c].empty()) {
+            if (_fifo[c].empty() || ++_fifo_passed[c] < starve_limit) {
+                task::impl &t = *_edf[c].begin();
+                _edf[c].erase(_edf[c].begin());
+                return t;
+            }
+        }
+        _fifo_passed[c] = 0;
+        task::impl &t = _fifo[c].front();
+        _fifo[c].pop_front();
+        return t;
+    }
+
+    void erase(task::impl &t) {
+        // where push put it, even if its priority changed since
+        const size_t c = t._ready_class;
+        if (t._edf_hook.is_linked()) {
+            _edf[c].erase(_edf[c].iterator_to(t));
+        } else {
+            _fifo[c].erase(_fifo[c].iterator_to(t));
+        }
+    }
+
+    stats get_stats() const {
+        stats s = _stats;
+        for (size_t c = 0; c < nclasses; ++c) {
+            s.depth[c] = size(c);
+        }
+        return s;
+    }
+};
+
+} // ten
+
+#endif
@@ -1,15 +1,21 @@
 #include "scheduler.hh"
 #include "thread_context.hh"
+#include "proc_group_impl.hh"
+#include "trace.hh"
 
 namespace ten {
 
 scheduler::scheduler()
   : _os_task{std::make_shared<task::impl>()},
+    _task_id_buckets(64),
+    _task_ids{task_id_set::bucket_traits(_task_id_buckets.data(), _task_id_buckets.size())},
     _current_task{_os_task.get()},
     _canceled{false}
 {
     _os_task->_scheduler.reset(this);
     update_cached_time();
+    // the os task is running now, its first swap accounts from here
+    _os_task->_run_start = _now;
 }
 
 scheduler::~scheduler() {
@@ -20,6 +26,7 @@ scheduler::~scheduler() {
     //XXX ^ this was moved to ~thread_context
     // because we need to finish all tasks before removing from thread list
     CHECK(_user_tasks.empty());
+    _free_tasks.clear_and_dispose(&task::impl::destroy);
     DVLOG(5) << "scheduler freed: " << this;
 }
 
@@ -27,7 +34,7 @@ void scheduler::shutdown() {
     if (!_shutdown_sequence_initiated) {
         _shutdown_sequence_initiated = true;
         for (auto &t : _user_tasks) {
-            t->cancel();
+            t.cancel();
         }
         _os_task->cancel();
     }
@@ -40,6 +47,11 @@ io& scheduler::get_io() {
     return *_io;
 }
 
+kernel::io_stats scheduler::io_stats() const {
+    if (!_io) return {};
+    return _io->stats();
+}
+
 void scheduler::wait_for_all() {
     DCHECK(_current_task.get() == _os_task.get());
     DVLOG(5) << "entering loop";
@@ -70,7 +82,7 @@ void scheduler::check_dirty_queue() {
     ptr<task::impl> t;
     while (_dirtyq.pop(t)) {
         DVLOG(5) << "dirty readying " << t;
-        _readyq.push_front(t);
+        _readyq.push_front(*t);
     }
 }
 
@@ -83,25 +95,106 @@ void scheduler::check_timeout_tasks() {
             t->_exception = exception;
         }
         DVLOG(5) << "TIMEOUT on task: " << t;
+        trace::event(trace::event_type::alarm, t->get_id());
         t->ready_for_io();
     });
 }
 
+void scheduler::check_group_work() {
+    // poll the group when there is nothing else to do,
+    // and now and then when busy so our own deque is not starved
+    if (!_group) return;
+    // pinned tasks can't go anywhere else, take them all
+    while (task::impl *t = _group->take_pinned(_group_slot)) {
+        DVLOG(5) << "pinned work: " << ptr<task::impl>{t};
+        attach_task(t->unpark());
+        t->ready();
+    }
+    _group->slots[_group_slot]->depth.store(_readyq.size(), std::memory_order_relaxed);
+    if (!_readyq.empty() && ++_schedtick % 61 != 0) return;
+    if (task::impl *t = _group->find_work(_group_slot)) {
+        DVLOG(5) << "group work: " << ptr<task::impl>{t};
+        attach_task(t->unpark());
+        t->ready(true);
+    }
+}
+
+bool scheduler::spin(optional<kernel::time_point> when) {
+    // while we spin _wake_state stays running, so other threads
+    // readying our tasks skip the eventfd write and futex wakeup
+    const auto start = kernel::clock::now();
+    auto end = start + _spin_budget;
+    if (when && *when < end) {
+        end = *when;
+    }
+    bool found = false;
+    for (;;) {
+        if (_wake_state.load(std::memory_order_relaxed) == notified) {
+            found = true;
+            break;
+        }
+        if (_io) {
+            // epoll_wait with zero timeout, readies tasks with io events
+            _io->wait(kernel::time_point::min());
+            if (!_readyq.empty()) {
+                found = true;
+                break;
+            }
+        }
+        if (_group && _group->has_work(_group_slot)) {
+            found = true;
+            break;
+        }
+        if (kernel::clock::now() >= end) break;
+    }
+    // spin longer while it pays off, back off when it doesn't
+    if (found) {
+        _spin_budget = std::min(_spin_max, _spin_budget * 2);
+    } else {
+        _spin_budget = std::max(_spin_max / 8, _spin_budget / 2);
+    }
+    update_cached_time();
+    return found;
+}
+
 void scheduler::wait(std::unique_lock <std::mutex> &lock, optional<kernel::time_point> when) {
     // do not wait if _readyq is not empty
     check_dirty_queue();
     if (!_readyq.empty()) return;
-    if (_io) {
-        lock.unlock();
-        _io->wait(when);
-        lock.lock();
-    } else {
-        if (when) {
-            _cv.wait_until(lock, *when);
+    if (_spin_max.count() && spin(when)) {
+        // the caller picks up whatever was found
+        _wake_state.store(running);
+        return;
+    }
+    if (_group) {
+        // advertise idle before the last look for work,
+        // see proc_group::impl::notify_idle
+        _group->set_idle(_group_slot, true);
+        if (_group->has_work(_group_slot)) {
+            _group->set_idle(_group_slot, false);
+            return;
+        }
+    }
+    int state = running;
+    if (_wake_state.compare_exchange_strong(state, sleeping)) {
+        if (_io) {
+            lock.unlock();
+            _io->wait(when);
+            lock.lock();
         } else {
-            _cv.wait(lock);
+            // wakeup() takes the lock to notify, so this can't miss it
+            if (when) {
+                _cv.wait_until(lock, *when);
+            } else {
+                _cv.wait(lock);
+            }
         }
     }
+    // consume the notify, _dirtyq is checked again by the caller
+    _wake_state.store(running);
+    if (_group) {
+        _group->set_idle(_group_slot, false);
+    }
     update_cached_time();
 }
 
@@ -116,21 +209,30 @@ void scheduler::schedule() {
         _os_task->ready();
     }
     const auto saved_task = _current_task;
+    trace::event(trace::event_type::swap_out, saved_task->get_id());
+    bool accounted = false;
     try {
         do {
             check_canceled();
             check_dirty_queue();
             check_timeout_tasks();
+            if (!accounted) {
+                // check_timeout_tasks just refreshed _now
+                account_run(saved_task);
+                accounted = true;
+            }
+            check_group_work();
             if (_readyq.empty()) {
                 auto when = _alarms.when();
                 std::unique_lock<std::mutex> lock{_mutex};
                 wait(lock, when);
             }
         } while (_readyq.empty());
-        const auto t = _readyq.front();
-        _readyq.pop_front();
+        const ptr<task::impl> t{&_readyq.pop()};
         DCHECK(t->_ready);
         t->_ready.store(false);
+        account_wait(t);
+        trace::event(trace::event_type::swap_in, t->get_id());
         _current_task = t;
         DVLOG(5) << this << " swapping to: " << t;
 #ifdef TEN_TASK_TRACE
@@ -148,10 +250,51 @@ void scheduler::schedule() {
     }
 }
 
+bool scheduler::recycle_task(task::impl &t) {
+    if (_free_tasks.size() >= max_free_tasks) return false;
+    t.recycle();
+    _free_tasks.push_back(t);
+    auto idle = _free_idle.pushed(_free_tasks.size());
+    if (idle.first < idle.second) {
+        auto it = std::next(_free_tasks.begin(), idle.first);
+        for (size_t i=idle.first; i<idle.second; ++i, ++it) {
+            it->trim_stack();
+        }
+    }
+    return true;
+}
+
+task::impl *scheduler::reuse_task(size_t stacksize) {
+    // only default size tasks are recycled, see release in task.cc
+    if (stacksize != stack_allocator::round_size(stack_allocator::default_stacksize)) {
+        return nullptr;
+    }
+    // all the same size unless the default stack size changed
+    while (!_free_tasks.empty()) {
+        task::impl &t = _free_tasks.back();
+        _free_tasks.pop_back();
+        _free_idle.popped(_free_tasks.size());
+        if (t._stack_size == stacksize) return &t;
+        task::impl::destroy(&t);
+    }
+    return nullptr;
+}
+
 void scheduler::attach_task(std::shared_ptr<task::impl> t) {
     DCHECK(t->_scheduler.get() == nullptr);
+    trace::event(trace::event_type::spawn, t->get_id(),
+            _current_task ? _current_task->get_id() : 0);
     t->_scheduler.reset(this);
-    _user_tasks.emplace_back(std::move(t));
+    _user_tasks.push_back(*t);
+    if (_task_ids.size() >= _task_id_buckets.size()) {
+        // keep the load factor at or below one
+        std::vector<task_id_set::bucket_type> buckets(_task_id_buckets.size() * 2);
+        _task_ids.rehash(task_id_set::bucket_traits(buckets.data(), buckets.size()));
+        _task_id_buckets.swap(buckets);
+    }
+    _task_ids.insert(*t);
+    task::impl &ti = *t;
+    ti._self = std::move(t);
 }
 
 void scheduler::remove_task(ptr<task::impl> t) {
@@ -163,35 +306,68 @@ void scheduler::remove_task(ptr<task::impl> t) {
         // another thread made us ready while we were exiting
         // this can happen with cancel or deadline for example
         // while waiting on a qutex or rendez
-        auto i = find(begin(_readyq), end(_readyq), t);
-        while (i == end(_readyq)) {
+        while (!run_queue::linked(*t)) {
             sched_yield();
             check_dirty_queue();
-            i = find(begin(_readyq), end(_readyq), t);
         }
-        _readyq.erase(i);
+        _readyq.erase(*t);
     }
-    DCHECK(find(begin(_readyq), end(_readyq), t) == end(_readyq))
+    DCHECK(!run_queue::linked(*t))
         << "BUG: " << t << " found in _readyq while being deleted";
-    auto i = find_if(begin(_user_tasks), end(_user_tasks), [=](std::shared_ptr<task::impl> &tt) -> bool {
-        return tt.get() == t.get();
-    });
-    DCHECK(i != end(_user_tasks));
-    _gctasks.emplace_back(*i);
-    _user_tasks.erase(i);
+    DCHECK(t->_tasks_hook.is_linked());
+    trace::event(trace::event_type::exit, t->get_id());
+    _user_tasks.erase(_user_tasks.iterator_to(*t));
+    _task_ids.erase(_task_ids.iterator_to(*t));
+    _gctasks.emplace_back(std::move(t->_self));
+}
+
+void scheduler::account_run(ptr<task::impl> t) {
+    // uses the cached time so accounting costs no clock reads
+    const auto ran = _now - t->_run_start;
+    t->_run_time += ran;
+    _run_time += ran;
+}
+
+void scheduler::account_wait(ptr<task::impl> t) {
+    ++t->_runs;
+    t->_run_start = _now;
+    const auto us = duration_cast<microseconds>(_now - t->_ready_at).count();
+    size_t bucket = 0;
+    while (bucket < kernel::ready_stats::nwait - 1 && us > (int64_t{1} << bucket)) {
+        ++bucket;
+    }
+    ++_wait_hist[bucket];
+}
+
+void scheduler::reorder(task::impl &t, task_priority p, kernel::time_point deadline) {
+    const bool linked = run_queue::linked(t);
+    if (linked) _readyq.erase(t);
+    t._priority = p;
+    t._deadline = deadline;
+    if (linked) _readyq.push_back(t);
+}
+
+run_queue::stats scheduler::ready_stats() const {
+    auto s = _readyq.get_stats();
+    std::copy(std::begin(_wait_hist), std::end(_wait_hist), std::begin(s.wait));
+    s.run_time = _run_time;
+    return s;
 }
 
 void scheduler::ready(ptr<task::impl> t, bool front) {
     DVLOG(5) << "readying: " << t;
     if (t->_ready.exchange(true) == false) {
+        // the readying thread's cached time, good enough for the histogram
+        t->_ready_at = this_ctx->scheduler._now;
         if (this != &this_ctx->scheduler) {
+            trace::event(trace::event_type::ready_remote, t->get_id());
             _dirtyq.push(t);
             wakeup();
         } else {
             if (front) {
-                _readyq.push_front(t);
+                _readyq.push_front(*t);
             } else {
-                _readyq.push_back(t);
+                _readyq.push_back(*t);
             }
         }
     }
@@ -200,33 +376,51 @@ void scheduler::ready(ptr<task::impl> t, bool front) {
 void scheduler::ready_for_io(ptr<task::impl> t) {
     DVLOG(5) << "readying for io: " << t;
     if (t->_ready.exchange(true) == false) {
-        _readyq.push_back(t);
+        t->_ready_at = _now;
+        _readyq.push_back(*t);
     }
 }
 
 void scheduler::unsafe_ready(ptr<task::impl> t) {
     DVLOG(5) << "readying: " << t;
-    _readyq.push_back(t);
+    t->_ready_at = _now;
+    _readyq.push_back(*t);
 }
 
 bool scheduler::cancel_task_by_id(uint64_t id) {
-    bool found = false;
-    for (auto &t : _user_tasks) {
-        if (t->get_id() == id) {
-            found = true;
-            t->cancel();
-            break;
-        }
+    auto i = _task_ids.find(id, task_id_hash(), task_id_equal());
+    if (i == _task_ids.end()) {
+        return false;
+    }
+    i->cancel();
+    return true;
+}
+
+void scheduler::join_group(ptr<proc_group::impl> g, size_t slot) {
+    DCHECK(!_group);
+    _group = g;
+    _group_slot = slot;
+    _group->join(slot, ptr<scheduler>{this});
+}
+
+void scheduler::leave_group() {
+    if (!_group) return;
+    auto left = _group->leave(_group_slot);
+    _group = nullptr;
+    for (task::impl *t : left) {
+        attach_task(t->unpark());
+        t->ready();
     }
-    return found;
 }
 
 void scheduler::wakeup() {
-    // TODO: speed this up?
-    std::unique_lock<std::mutex> lock{_mutex};
+    // only the first notify after the scheduler goes to sleep
+    // has to do anything. _io can't change while it is sleeping.
+    if (_wake_state.exchange(notified) != sleeping) return;
     if (_io) {
         _io->wakeup();
     } else {
+        std::lock_guard<std::mutex> lock{_mutex};
         _cv.notify_one();
     }
 }
@@ -238,9 +432,9 @@ void scheduler::dump() const {
     LOG(INFO) << _os_task->_trace.str();
 #endif
     for (auto &t : _user_tasks) {
-        LOG(INFO) << ptr<task::impl>{t.get()};
+        LOG(INFO) << ptr<task::impl>{const_cast<task::impl *>(&t)};
 #ifdef TEN_TASK_TRACE
-        LOG(INFO) << t->_trace.str();
+        LOG(INFO) << t._trace.str();
 #endif
     }
     FlushLogFiles(INFO);
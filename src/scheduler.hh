@@ -6,6 +6,9 @@
 #include "ten/llqueue.hh"
 #include "alarm.hh"
 #include "io.hh"
+#include "stack_alloc.hh"
+#include "run_queue.hh"
+#include "ten/task/proc_group.hh"
 
 namespace ten {
 
@@ -17,6 +20,28 @@ class scheduler {
     friend class kernel;
 public:
     typedef ten::alarm_clock<ptr<task::impl>, kernel::clock> alarm_clock;
+private:
+    typedef boost::intrusive::list<task::impl,
+            boost::intrusive::member_hook<task::impl,
+                boost::intrusive::list_member_hook<>,
+                &task::impl::_tasks_hook>> task_list;
+
+    struct task_id_hash {
+        size_t operator()(uint64_t id) const { return std::hash<uint64_t>()(id); }
+        size_t operator()(const task::impl &t) const { return (*this)(t.get_id()); }
+    };
+    struct task_id_equal {
+        bool operator()(const task::impl &a, const task::impl &b) const { return a.get_id() == b.get_id(); }
+        bool operator()(uint64_t id, const task::impl &t) const { return id == t.get_id(); }
+    };
+    typedef boost::intrusive::unordered_set<task::impl,
+            boost::intrusive::member_hook<task::impl,
+                boost::intrusive::unordered_set_member_hook<>,
+                &task::impl::_id_hook>,
+            boost::intrusive::hash<task_id_hash>,
+            boost::intrusive::equal<task_id_equal>,
+            boost::intrusive::power_2_buckets<true>> task_id_set;
+public:
 
     //! return an armed alarm, used by sleep_until, deadline, and io timeouts
     template <class ...Args>
@@ -26,18 +51,26 @@ public:
 private:
     //! task representing OS allocated stack for this thread
     std::shared_ptr<task::impl> _os_task;
-    //! all other tasks known to this scheduler
-    std::deque<std::shared_ptr<task::impl>> _user_tasks;
+    //! all other tasks known to this scheduler,
+    // each owned by its task::impl::_self while attached
+    task_list _user_tasks;
+    //! buckets for _task_ids, grown as tasks are attached
+    std::vector<task_id_set::bucket_type> _task_id_buckets;
+    //! index of _user_tasks by id
+    task_id_set _task_ids;
     //! ptr to the currently running task
     ptr<task::impl> _current_task;
     //! queue of tasks ready to run
-    std::deque<ptr<task::impl>> _readyq;
+    run_queue _readyq;
     //! other threads use this to add tasks to ready queue
     llqueue<ptr<task::impl>> _dirtyq;
     //! epoll io
     optional<io> _io;
     //! tasks to be garbage collected in the next scheduler iteration
     std::deque<std::shared_ptr<task::impl>> _gctasks;
+    //! exited tasks kept with their stacks for task::impl::create
+    task_list _free_tasks;
+    stack_allocator::idle_tracker _free_idle;
     //! current time cached in a few places through the event loop
     kernel::time_point _now;
     //! tasks with pending timeouts
@@ -48,6 +81,13 @@ private:
     //! cond used to wake up when runqueue is empty and no epoll
     std::condition_variable _cv;
 
+    //! states for _wake_state
+    enum { running, sleeping, notified };
+    //! lets other threads skip waking us unless we are really asleep.
+    // wakeup() sets notified, wait() only sleeps if it can move
+    // running to sleeping, so a notify is never lost.
+    std::atomic<int> _wake_state{running};
+
     //! true when canceled
     std::atomic<bool> _canceled;
     //! scheduler is trying to shutdown
@@ -55,9 +95,30 @@ private:
     //! main task is looping in wait_for_all
     bool _looping = false;
 
+    //! work-stealing group this scheduler belongs to, if any
+    ptr<proc_group::impl> _group;
+    //! index of this scheduler in the group
+    size_t _group_slot = 0;
+    //! iterations of the schedule loop, used to poll the group when busy
+    uint64_t _schedtick = 0;
+
+    //! ready queue wait histogram, see kernel::ready_stats
+    uint64_t _wait_hist[kernel::ready_stats::nwait] = {};
+    //! time tasks spent running
+    kernel::duration _run_time{0};
+
+    //! longest busy-poll before sleeping, zero disables it
+    std::chrono::microseconds _spin_max{0};
+    //! current busy-poll budget, adapts to how often spinning finds work
+    std::chrono::microseconds _spin_budget{0};
+
     void check_canceled();
     void check_dirty_queue();
     void check_timeout_tasks();
+    void check_group_work();
+    bool spin(optional<kernel::time_point> when);
+    void account_run(ptr<task::impl> t);
+    void account_wait(ptr<task::impl> t);
 
     const kernel::time_point & update_cached_time() {
         _now = kernel::clock::now();
@@ -79,6 +140,8 @@ public:
 
     //! get io manager for this scheduler
     io &get_io();
+    //! io stats, zero until io is first used
+    kernel::io_stats io_stats() const;
 
     //! wait for all tasks to exit
     // will only work if called from main task
@@ -87,14 +150,33 @@ public:
     //! run one iteration of the scheduler
     void schedule();
 
+    //! most exited tasks kept for reuse
+    static constexpr size_t max_free_tasks = 256;
+    //! keep an exited task for reuse, false if the free list is full
+    bool recycle_task(task::impl &t);
+    //! a recycled task with a stack of stacksize, or null
+    task::impl *reuse_task(size_t stacksize);
+
     void attach_task(std::shared_ptr<task::impl> t);
     void remove_task(ptr<task::impl> t);
 
     void wakeup();
     void wait(std::unique_lock <std::mutex> &lock, optional<kernel::time_point> when);
 
+    //! poll for work for up to max before sleeping, see kernel::set_busy_poll
+    void set_busy_poll(std::chrono::microseconds max) {
+        _spin_max = _spin_budget = max;
+    }
+
     bool cancel_task_by_id(uint64_t id);
 
+    //! start taking tasks from group g
+    void join_group(ptr<proc_group::impl> g, size_t slot);
+    //! stop taking tasks from the group, attach any left in our slot
+    void leave_group();
+    ptr<proc_group::impl> group() const { return _group; }
+    size_t group_slot() const { return _group_slot; }
+
     void cancel() {
         _canceled = true;
         wakeup();
@@ -102,6 +184,12 @@ public:
 
     void dump() const;
 
+    run_queue::stats ready_stats() const;
+    void set_edf(bool on) { _readyq.set_edf(on); }
+    //! change t's priority and deadline, re-queueing it if it is ready
+    // since the run_queue is keyed by both
+    void reorder(task::impl &t, task_priority p, kernel::time_point deadline);
+
     static ptr<task::impl> current_task();
 private:
     friend class task;
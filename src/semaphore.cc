@@ -0,0 +1,85 @@
+#include "ten/task/semaphore.hh"
+#include "ten/task.hh"
+
+namespace ten {
+
+void task_semaphore::acquire() {
+    std::unique_lock<qutex> lk{_q};
+    _r.sleep(lk, [&] { return _count > 0; });
+    --_count;
+}
+
+bool task_semaphore::try_acquire() {
+    std::unique_lock<qutex> lk{_q};
+    if (_count == 0) return false;
+    --_count;
+    return true;
+}
+
+bool task_semaphore::try_acquire_for(std::chrono::milliseconds ms) {
+    if (ms.count() <= 0) return try_acquire();
+    std::unique_lock<qutex> lk{_q};
+    if (!_r.sleep_until(lk, kernel::now() + ms, [&] { return _count > 0; })) {
+        return false;
+    }
+    --_count;
+    return true;
+}
+
+void task_semaphore::release(size_t n) {
+    std::unique_lock<qutex> lk{_q};
+    _count += n;
+    for (size_t i = 0; i < n; ++i) {
+        _r.wakeup();
+    }
+}
+
+void latch::count_down(size_t n) {
+    std::unique_lock<qutex> lk{_q};
+    DCHECK(n <= _count) << "BUG: latch counted below zero";
+    _count -= n;
+    if (_count == 0) {
+        _r.wakeupall();
+    }
+}
+
+bool latch::try_wait() {
+    std::unique_lock<qutex> lk{_q};
+    return _count == 0;
+}
+
+void latch::wait() {
+    std::unique_lock<qutex> lk{_q};
+    _r.sleep(lk, [&] { return _count == 0; });
+}
+
+void latch::arrive_and_wait(size_t n) {
+    std::unique_lock<qutex> lk{_q};
+    DCHECK(n <= _count) << "BUG: latch counted below zero";
+    _count -= n;
+    if (_count == 0) {
+        _r.wakeupall();
+        return;
+    }
+    _r.sleep(lk, [&] { return _count == 0; });
+}
+
+void wait_group::add(size_t n) {
+    std::unique_lock<qutex> lk{_q};
+    _count += n;
+}
+
+void wait_group::done() {
+    std::unique_lock<qutex> lk{_q};
+    DCHECK(_count > 0) << "BUG: wait_group done without add";
+    if (--_count == 0) {
+        _r.wakeupall();
+    }
+}
+
+void wait_group::wait() {
+    std::unique_lock<qutex> lk{_q};
+    _r.sleep(lk, [&] { return _count == 0; });
+}
+
+} // namespace
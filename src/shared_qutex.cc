@@ -0,0 +1,154 @@
+#include "ten/task/shared_qutex.hh"
+#include "scheduler.hh"
+#include <algorithm>
+
+namespace ten {
+
+struct shared_qutex::waiter {
+    ptr<task::impl> t;
+    bool exclusive;
+    //! set by grant, the lock is ours
+    bool granted = false;
+
+    waiter(ptr<task::impl> t_, bool exclusive_) : t{t_}, exclusive{exclusive_} {}
+};
+
+void shared_qutex::lock(qutex::lock_type_t lt) {
+    uint64_t unlocked = 0;
+    if (_state.compare_exchange_strong(unlocked, writer, std::memory_order_acquire)) {
+        return;
+    }
+    lock_slow(true, lt);
+}
+
+bool shared_qutex::try_lock() {
+    uint64_t unlocked = 0;
+    return _state.compare_exchange_strong(unlocked, writer, std::memory_order_acquire);
+}
+
+void shared_qutex::unlock() {
+    uint64_t locked = writer;
+    if (_state.compare_exchange_strong(locked, 0, std::memory_order_release)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lk{_m};
+    _state.fetch_and(~writer, std::memory_order_release);
+    grant();
+}
+
+bool shared_qutex::try_lock_shared() {
+    uint64_t s = _state.load(std::memory_order_relaxed);
+    while (!(s & (writer | pending))) {
+        if (_state.compare_exchange_weak(s, s + 1, std::memory_order_acquire)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void shared_qutex::lock_shared(qutex::lock_type_t lt) {
+    if (try_lock_shared()) return;
+    lock_slow(false, lt);
+}
+
+void shared_qutex::unlock_shared() {
+    // acq_rel so the last reader out, which runs grant, has seen
+    // the critical sections of the readers that left before it
+    const uint64_t s = _state.fetch_sub(1, std::memory_order_acq_rel);
+    DCHECK(s & readers_mask) << "BUG: unlock_shared without lock_shared";
+    if ((s & pending) && (s & readers_mask) == 1) {
+        // last reader out and someone is queued
+        std::lock_guard<std::mutex> lk{_m};
+        grant();
+    }
+}
+
+void shared_qutex::lock_slow(bool exclusive, qutex::lock_type_t lt) {
+    const auto t = scheduler::current_task();
+    DCHECK(t) << "BUG: shared_qutex locked outside of task";
+    DCHECK(!t->cancelable()) << "BUG: cannot cancel a lock";
+    waiter w{t, exclusive};
+    {
+        std::lock_guard<std::mutex> lk{_m};
+        uint64_t s = _state.load(std::memory_order_relaxed);
+        for (;;) {
+            if (s & pending) {
+                // pending only changes under _m
+                break;
+            }
+            const bool free = exclusive ? s == 0 : !(s & writer);
+            if (free) {
+                if (_state.compare_exchange_weak(s, exclusive ? writer : s + 1,
+                            std::memory_order_acquire)) {
+                    return;
+                }
+            } else if (_state.compare_exchange_weak(s, s | pending, std::memory_order_relaxed)) {
+                // holders can't leave through the fast path now
+                break;
+            }
+        }
+        _waiting.push_back(&w);
+    }
+
+    // loop to handle spurious wakeups from other threads
+    try {
+        for (;;) {
+            DCHECK(!t->cancelable()) << "BUG: cannot cancel a lock";
+            switch (lt) {
+                case qutex::safe_lock:
+                    t->safe_swap(); // don't allow swap to throw on deadline timeout
+                    break;
+                case qutex::interruptable_lock:
+                default:
+                    t->swap();
+            }
+            std::lock_guard<std::mutex> lk{_m};
+            if (w.granted) {
+                break;
+            }
+        }
+    } catch (...) {
+        // deadline timeouts can trigger this
+        std::lock_guard<std::mutex> lk{_m};
+        if (w.granted) {
+            // got it anyway, give it back
+            _state.fetch_sub(exclusive ? writer : 1, std::memory_order_acq_rel);
+        } else {
+            _waiting.erase(std::find(_waiting.begin(), _waiting.end(), &w));
+            if (_waiting.empty()) {
+                _state.fetch_and(~pending, std::memory_order_relaxed);
+            }
+        }
+        // a writer leaving the front may let readers in
+        grant();
+        throw;
+    }
+}
+
+void shared_qutex::grant() {
+    // called holding _m. while pending is set only departing
+    // readers change _state behind our back
+    while (!_waiting.empty()) {
+        waiter *w = _waiting.front();
+        // acquire pairs with readers leaving outside _m
+        const uint64_t s = _state.load(std::memory_order_acquire);
+        if (w->exclusive) {
+            if (s & (writer | readers_mask)) return;
+            _waiting.pop_front();
+            _state.store(writer | (_waiting.empty() ? 0 : pending), std::memory_order_relaxed);
+            w->granted = true;
+            w->t->ready();
+            return;
+        }
+        if (s & writer) return;
+        _waiting.pop_front();
+        _state.fetch_add(1, std::memory_order_relaxed);
+        if (_waiting.empty()) {
+            _state.fetch_and(~pending, std::memory_order_relaxed);
+        }
+        w->granted = true;
+        w->t->ready();
+    }
+}
+
+} // namespace
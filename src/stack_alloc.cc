@@ -4,12 +4,15 @@
 #include <sys/mman.h>
 #include <algorithm>
 #include <atomic>
+#include <array>
 
 namespace ten {
 
 namespace stack_allocator {
 
 size_t default_stacksize{ (size_t)256 * 1024 };
+std::atomic<size_t> reclaim_keep{ (size_t)64 * 1024 };
+std::atomic<unsigned> reclaim_sample{ 32 };
 
 // impl
 
@@ -54,29 +57,115 @@ struct stack {
     }
 };
 
+struct stats_tag {};
+thread_cached<stats_tag, kernel::stack_stats> stack_stats;
+
+//! depth of the deepest resident page, scanning up from the guard page
+size_t resident_depth(void *stack_ptr, size_t stack_size) {
+    const size_t npages = stack_size / page_size;
+    unsigned char small[size_classes[3] / page_size];
+    std::unique_ptr<unsigned char[]> big;
+    unsigned char *vec = small;
+    if (npages > sizeof(small)) {
+        big.reset(new unsigned char[npages]);
+        vec = big.get();
+    }
+    if (mincore(stack_ptr, stack_size, vec) == -1) {
+        return stack_size;
+    }
+    for (size_t i=1; i<npages; ++i) {
+        if (vec[i] & 1) {
+            return (npages - i) * page_size;
+        }
+    }
+    return 0;
+}
+
+//! madvise away the pages between depth from the top and reclaim_keep,
+// never touching the reserved bytes at the top. returns the bytes released
+size_t trim_below(void *stack_ptr, size_t stack_size, size_t depth, size_t reserved) {
+    const size_t want = std::max(reclaim_keep.load(std::memory_order_relaxed), reserved);
+    const size_t keep = (want + page_size - 1) & ~(page_size - 1);
+    if (depth <= keep) return 0;
+    char *top = static_cast<char *>(stack_ptr) + stack_size;
+    const size_t len = depth - keep;
+    if (madvise(top - depth, len, MADV_DONTNEED) == -1) return 0;
+    return len;
+}
+
+//! record the high-water mark of a stack being released
+// and madvise away the pages deeper than reclaim_keep.
+// mincore is a syscall, so cached stacks are only sampled,
+// the rest are trimmed once they sit idle, see idle_tracker
+void reclaim(void *stack_ptr, size_t stack_size, bool cached, size_t reserved) {
+    auto &stats = *stack_stats;
+    if (cached && ++stats.released % reclaim_sample.load(std::memory_order_relaxed) != 0) {
+        return;
+    }
+    if (!cached) ++stats.released;
+    ++stats.sampled;
+    const size_t depth = resident_depth(stack_ptr, stack_size);
+    size_t bucket = 0;
+    while (bucket < kernel::stack_stats::nbuckets - 1 && depth > (page_size << bucket)) {
+        ++bucket;
+    }
+    ++stats.highwater[bucket];
+    if (!cached) return;
+    stats.reclaimed += trim_below(stack_ptr, stack_size, depth, reserved);
+}
+
+constexpr size_t nclasses = sizeof(size_classes) / sizeof(size_classes[0]);
+
+struct class_cache {
+    std::vector<stack> stacks;
+    idle_tracker idle;
+};
+
 struct cache_tag {};
-thread_cached<cache_tag, std::vector<stack>> stack_cache;
+thread_cached<cache_tag, std::array<class_cache, nclasses>> stack_cache;
+
+//! cache for a rounded stack size, or nullptr if it is too big to cache
+class_cache *cache_for(size_t stack_size) {
+    for (size_t i=0; i<nclasses; ++i) {
+        if (stack_size == size_classes[i]) {
+            return &(*stack_cache)[i];
+        }
+    }
+    return nullptr;
+}
 
 } // anon
 
 // calling this function ensures all the above have been initialized
 int initialize() { return 0; }
 
-void gc_cache(std::vector<stack> &cache) {
+const kernel::stack_stats &thread_stats() {
+    return *stack_stats;
+}
+
+void gc_cache(class_cache &cache) {
     // reduce cache size by 20%
-    const size_t n = cache.size() / 5;
+    const size_t n = cache.stacks.size() / 5;
     if (n) {
-        cache.erase(end(cache) - n, end(cache));
-        cache.shrink_to_fit();
+        cache.stacks.erase(end(cache.stacks) - n, end(cache.stacks));
+        cache.stacks.shrink_to_fit();
+        cache.idle.popped(cache.stacks.size());
     }
 }
 
+size_t round_size(size_t stack_size) {
+    for (size_t cls : size_classes) {
+        if (stack_size <= cls) return cls;
+    }
+    return (stack_size + page_size - 1) & ~(page_size - 1);
+}
+
 void *allocate(size_t stack_size) {
-    // TODO: check stack_size >= min_stacksize (8k because of 4k guard page)
-    auto &cache = *stack_cache;
+    stack_size = round_size(stack_size);
+    auto cache = cache_for(stack_size);
 
     void *stack_ptr = nullptr;
-    if (cache.empty()) {
+    if (!cache || cache->stacks.empty()) {
         stack_ptr = mmap(nullptr, stack_size, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE|MAP_STACK, 0, 0);
         if (stack_ptr == MAP_FAILED) {
             alloc_fail.store(true);
@@ -88,26 +177,53 @@ void *allocate(size_t stack_size) {
             throw bad_stack_alloc();
         }
     } else {
-        auto &reuse = cache.back();
-        CHECK(reuse.size == stack_size);
+        auto &reuse = cache->stacks.back();
+        DCHECK(reuse.size == stack_size);
         stack_ptr = reuse.release();
-        cache.pop_back();
-        if (!cache.empty() && alloc_fail.exchange(false)) {
-            gc_cache(cache);
+        cache->stacks.pop_back();
+        cache->idle.popped(cache->stacks.size());
+        if (!cache->stacks.empty() && alloc_fail.exchange(false)) {
+            gc_cache(*cache);
         }
     }
     return static_cast<char *>(stack_ptr) + stack_size;
 }
 
+void recycled(void *stack_end, size_t stack_size, size_t reserved) noexcept {
+    stack_size = round_size(stack_size);
+    void *stack_ptr = static_cast<char *>(stack_end) - stack_size;
+    reclaim(stack_ptr, stack_size, true, reserved);
+}
+
+void trim(void *stack_end, size_t stack_size, size_t reserved) noexcept {
+    stack_size = round_size(stack_size);
+    void *stack_ptr = static_cast<char *>(stack_end) - stack_size;
+    // not measured, so from just above the guard page
+    if (trim_below(stack_ptr, stack_size, stack_size - page_size, reserved)) {
+        ++stack_stats->trimmed;
+    }
+}
+
 void deallocate(void *stack_end, size_t stack_size) noexcept {
+    stack_size = round_size(stack_size);
     void *stack_ptr = static_cast<char *>(stack_end) - stack_size;
-    auto &cache = *stack_cache;
+    auto cache = cache_for(stack_size);
+    reclaim(stack_ptr, stack_size, cache != nullptr, 0);
+    if (!cache) {
+        free_stack(stack_ptr, stack_size);
+        return;
+    }
     try {
-        if (!cache.empty() && alloc_fail.exchange(false)) {
+        if (!cache->stacks.empty() && alloc_fail.exchange(false)) {
             free_stack(stack_ptr, stack_size);
-            gc_cache(cache);
+            gc_cache(*cache);
         } else {
-            cache.emplace_back(stack_ptr, stack_size);
+            cache->stacks.emplace_back(stack_ptr, stack_size);
+            auto idle = cache->idle.pushed(cache->stacks.size());
+            for (size_t i=idle.first; i<idle.second; ++i) {
+                auto &st = cache->stacks[i];
+                trim(static_cast<char *>(st.ptr) + st.size, st.size);
+            }
         }
     } catch (std::bad_alloc &e) {
         free_stack(stack_ptr, stack_size);
@@ -2,6 +2,9 @@
 #define LIBTEN_TASK_STACK_ALLOC_HH_
 
 #include <memory>
+#include <atomic>
+#include <algorithm>
+#include "ten/task/kernel.hh"
 
 namespace ten {
 
@@ -15,12 +18,64 @@ namespace stack_allocator {
     constexpr size_t page_size = 4096;
     constexpr size_t min_stacksize = page_size * 2;
 
+    //! stacks are cached per thread in these sizes
+    constexpr size_t size_classes[] = {
+        16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024 };
+
     extern size_t default_stacksize;
 
+    //! resident bytes a cached stack may keep, see kernel::set_stack_reclaim
+    extern std::atomic<size_t> reclaim_keep;
+    extern std::atomic<unsigned> reclaim_sample;
+
+    //! high-water and reclaim stats for this thread
+    const kernel::stack_stats &thread_stats();
+
     int initialize();
 
+    //! round up to the next size class, or to whole pages when
+    // larger than the biggest class (those stacks are not cached)
+    size_t round_size(size_t stack_size);
+
+    //! returns the high end of a stack of at least stack_size bytes
     void *allocate(size_t stack_size);
     void deallocate(void *stack_end, size_t stack_size) noexcept;
+    //! what deallocate does to a cached stack without freeing it,
+    // for stacks kept by their task, see task::impl::recycle.
+    // the reserved bytes at the top are in use and never trimmed
+    void recycled(void *stack_end, size_t stack_size, size_t reserved) noexcept;
+    //! madvise away the pages of an idle stack deeper than reclaim_keep
+    void trim(void *stack_end, size_t stack_size, size_t reserved=0) noexcept;
+
+    //! finds stacks left unused in a LIFO cache
+    //
+    //! the cache reports its size after every push and pop. entries
+    // below the lowest size seen since the last sweep were not touched
+    // in that time, so every sweep_every pushes the ones not trimmed yet
+    // are due. steady reuse never gets down to them, the stacks a burst
+    // of tasks leaves behind do
+    struct idle_tracker {
+        static constexpr unsigned sweep_every = 256;
+        size_t low_water = 0;
+        //! entries below this were trimmed and not reused since
+        size_t trimmed = 0;
+        unsigned pushes = 0;
+
+        void popped(size_t size) {
+            low_water = std::min(low_water, size);
+            trimmed = std::min(trimmed, size);
+        }
+
+        //! entries [first, second) from the bottom to trim now
+        std::pair<size_t, size_t> pushed(size_t size) {
+            if (++pushes < sweep_every) return {0, 0};
+            pushes = 0;
+            const size_t first = trimmed;
+            trimmed = std::max(trimmed, low_water);
+            low_water = size;
+            return {first, trimmed};
+        }
+    };
 };
 
 } // ten
@@ -1,11 +1,68 @@
 #include "thread_context.hh"
 #include <stdexcept>
+#include <cstring>
 #include <inttypes.h>
 
 namespace ten {
 
 namespace {
 std::atomic<uint64_t> taskidgen(0);
+
+//! room at the top of each task stack for the shared_ptr
+// control block and below it task::impl
+const size_t impl_size = (sizeof(task::impl) + 63) & ~size_t{63};
+const size_t cb_size = 128;
+const size_t tcb_size = impl_size + cb_size;
+// kernel::set_stack_reclaim keeps at least a page
+static_assert(tcb_size <= stack_allocator::page_size, "task::impl outgrew a page");
+
+char *stack_top(task::impl *t) {
+    return reinterpret_cast<char *>(t) + tcb_size;
+}
+
+//! put a task whose last reference went away on this thread's free list,
+// or destroy it with its stack. only tasks with the default stack size
+// are kept, they are nearly all of them
+void release(task::impl *t) noexcept {
+    if (this_ctx && t->stack_size() == stack_allocator::round_size(stack_allocator::default_stacksize)
+            && this_ctx->scheduler.recycle_task(*t)) {
+        return;
+    }
+    task::impl::destroy(t);
+}
+
+//! hands out the control block slot at the top of a task stack.
+// freeing the control block is the last thing shared_ptr does,
+// and the block lives on the stack, so that is when the task goes
+template <class T>
+struct stack_arena {
+    typedef T value_type;
+
+    char *top;
+
+    explicit stack_arena(char *top_) : top{top_} {}
+    template <class U>
+        stack_arena(const stack_arena<U> &other) : top{other.top} {}
+
+    T *allocate(size_t n) {
+        CHECK(n * sizeof(T) <= cb_size) << "BUG: task control block too big";
+        return reinterpret_cast<T *>(top - cb_size);
+    }
+
+    void deallocate(T *, size_t) noexcept {
+        release(reinterpret_cast<task::impl *>(top - tcb_size));
+    }
+};
+
+template <class T, class U>
+bool operator == (const stack_arena<T> &a, const stack_arena<U> &b) { return a.top == b.top; }
+template <class T, class U>
+bool operator != (const stack_arena<T> &a, const stack_arena<U> &b) { return a.top != b.top; }
+
+//! the task is released with its control block, see stack_arena
+struct task_deleter {
+    void operator()(task::impl *) const noexcept {}
+};
 }
 
 std::ostream &operator << (std::ostream &o, ptr<task::impl> t) {
@@ -13,7 +70,9 @@ std::ostream &operator << (std::ostream &o, ptr<task::impl> t) {
         o << "[" << (void*)t.get() << " " << t->get_id() << " "
           << t->getname() << " |" << t->getstate()
           << "| canceled: " << t->_canceled
-          << " ready: " << t->_ready << "]";
+          << " ready: " << t->_ready
+          << " runs: " << t->_runs
+          << " cpu: " << duration_cast<microseconds>(t->_run_time).count() << "us]";
     } else {
         o << "nulltask";
     }
@@ -31,6 +90,15 @@ void yield() {
     t->yield();
 }
 
+void set_priority(task_priority p) {
+    const auto t = scheduler::current_task();
+    this_ctx->scheduler.reorder(*t, p, t->_deadline);
+}
+
+task_priority get_priority() {
+    return scheduler::current_task()->_priority;
+}
+
 void sleep_until(const kernel::time_point& sleep_time) {
     task::impl::cancellation_point cancellable;
     const auto t = scheduler::current_task();
@@ -41,8 +109,8 @@ void sleep_until(const kernel::time_point& sleep_time) {
 } // this_task
 
 
-task::task(std::function<void ()> f)
-    : _impl{std::make_shared<task::impl>(std::move(f), stack_allocator::default_stacksize)}
+task::task(const fn_ops &ops, void *arg, optional<size_t> stacksize)
+    : _impl{task::impl::create(ops, arg, stacksize.value_or(stack_allocator::default_stacksize))}
 {
     this_ctx->scheduler.attach_task(_impl);
     // add new tasks to front of runqueue
@@ -78,9 +146,10 @@ void task::join() {
 task::impl::impl()
     : _ctx{},
     _cancel_points{0},
-    _aux{new auxinfo{}},
+    _aux{},
     _id{++taskidgen},
-    _fn{},
+    _fn_ops{nullptr},
+    _fn{nullptr},
     _ready{false},
     _canceled{false}
 {
@@ -88,24 +157,126 @@ task::impl::impl()
     setstate("new");
 }
 
-task::impl::impl(std::function<void ()> f, size_t stacksize)
-    : _ctx{task::impl::trampoline, stacksize},
+task::impl::impl(const task::fn_ops &ops, void *fn, size_t stacksize)
+    : _ctx{task::impl::trampoline, fn, stacksize},
     _cancel_points{0},
-    _aux{new auxinfo{}},
+    _aux{},
     _id{++taskidgen},
-    _fn{std::move(f)},
+    _fn_ops{&ops},
+    _fn{fn},
     _ready{false},
     _canceled{false}
 {
-    setname("task[%" PRId64 "]", _id);
-    setstate("new");
+    // name is left empty for getname, formatting it costs as much as the rest
+    memcpy(_aux.state, "new", 4);
+}
+
+task::impl::~impl() {
+    // tasks that never ran still own their callable
+    if (_fn) {
+        _fn_ops->destroy(_fn);
+    }
+}
+
+std::shared_ptr<task::impl> task::impl::create(const task::fn_ops &ops, void *arg, size_t stacksize) {
+    // layout from the top of the stack down:
+    // control block, task::impl, callable, then the stack itself
+    stacksize = stack_allocator::round_size(stacksize);
+    task::impl *t = this_ctx ? this_ctx->scheduler.reuse_task(stacksize) : nullptr;
+    char *top = t ? stack_top(t) : static_cast<char *>(stack_allocator::allocate(stacksize));
+    auto release = [&] {
+        if (t) {
+            destroy(t);
+        } else {
+            stack_allocator::deallocate(top, stacksize);
+        }
+    };
+    const size_t align = std::max(ops.align, size_t{16});
+    char *fn = reinterpret_cast<char *>(
+            reinterpret_cast<uintptr_t>(top - tcb_size - ops.size) & ~(align - 1));
+    const size_t used = top - fn;
+    if (used + stack_allocator::min_stacksize > stacksize) {
+        release();
+        throw errorx("task callable too big for stack: %zu bytes", ops.size);
+    }
+    try {
+        ops.construct(fn, arg);
+    } catch (...) {
+        release();
+        throw;
+    }
+    if (t) {
+        t->reuse(ops, fn, stacksize - used);
+    } else {
+        t = new (top - tcb_size) task::impl(ops, fn, stacksize - used);
+        t->_stack_size = stacksize;
+    }
+    // from here the control block owns the task and its stack
+    return std::shared_ptr<task::impl>(t, task_deleter{}, stack_arena<task::impl>{top});
+}
+
+void task::impl::destroy(impl *t) noexcept {
+    char *top = stack_top(t);
+    const size_t size = t->_stack_size;
+    t->~impl();
+    stack_allocator::deallocate(top, size);
+}
+
+void task::impl::recycle() noexcept {
+    DCHECK(!_self && !run_queue::linked(*this) && !_tasks_hook.is_linked());
+    if (_fn) {
+        _fn_ops->destroy(_fn);
+        _fn = nullptr;
+    }
+    _scheduler = nullptr;
+    _priority = task_priority::normal;
+    _deadline = kernel::time_point::max();
+    _exception = nullptr;
+    _cancel_points = 0;
+    _ready = false;
+    _canceled = false;
+    _join([](joininfo &i) {
+        i.finished = false;
+        i.joiner = nullptr;
+    });
+    _run_time = kernel::duration{0};
+    _runs = 0;
+    // measure like a stack going back to the cache would
+    // the task and its control block stay live at the top
+    stack_allocator::recycled(stack_top(this), _stack_size, tcb_size);
+}
+
+void task::impl::trim_stack() noexcept {
+    stack_allocator::trim(stack_top(this), _stack_size, tcb_size);
+}
+
+void task::impl::reuse(const task::fn_ops &ops, void *fn, size_t stacksize) {
+    _ctx.reset(task::impl::trampoline, fn, stacksize);
+    _id = ++taskidgen;
+    _fn_ops = &ops;
+    _fn = fn;
+    _aux.name[0] = '\0';
+    memcpy(_aux.state, "new", 4);
+}
+
+task::impl *task::impl::park(std::shared_ptr<impl> t) {
+    task::impl *p = t.get();
+    DCHECK(!p->_self && !p->_scheduler);
+    p->_self = std::move(t);
+    return p;
+}
+
+std::shared_ptr<task::impl> task::impl::unpark() {
+    DCHECK(_self && !_scheduler);
+    return std::move(_self);
 }
 
 void task::impl::trampoline(intptr_t arg) {
     const ptr<task::impl> t{reinterpret_cast<task::impl *>(arg)};
     if (!t->_canceled) {
-        task::entry(t->_fn);
+        task::entry([t] { t->_fn_ops->invoke(t->_fn); });
     }
+    t->_fn_ops->destroy(t->_fn);
     t->_fn = nullptr;
     t->_join([](joininfo &i){
         DCHECK(!i.finished);
@@ -151,7 +322,14 @@ void task::impl::setname(const char *fmt, ...) {
 }
 
 void task::impl::vsetname(const char *fmt, va_list arg) {
-    vsnprintf(_aux->name, namesize, fmt, arg);
+    vsnprintf(_aux.name, namesize, fmt, arg);
+}
+
+const char *task::impl::getname() const {
+    if (_aux.name[0] == '\0') {
+        snprintf(_aux.name, namesize, "task[%" PRId64 "]", _id);
+    }
+    return _aux.name;
 }
 
 void task::impl::setstate(const char *fmt, ...) {
@@ -162,7 +340,7 @@ void task::impl::setstate(const char *fmt, ...) {
 }
 
 void task::impl::vsetstate(const char *fmt, va_list arg) {
-    vsnprintf(_aux->state, statesize, fmt, arg);
+    vsnprintf(_aux.state, statesize, fmt, arg);
 }
 
 void task::impl::yield() {
@@ -247,8 +425,7 @@ task::impl::cancellation_point::~cancellation_point() {
 
 // should be in compat.cc but here because of current_stacksize mess
 uint64_t taskspawn(const std::function<void ()> &f, size_t stacksize) {
-    // XXX: stacksize is ignored now
-    task t = task::spawn(std::move(f));
+    task t = stacksize ? task::spawn(f, stacksize) : task::spawn(f);
     return t.get_id();
 }
 
@@ -4,6 +4,9 @@
 #include <memory>
 #include <thread>
 #include <atomic>
+#include <boost/intrusive/list.hpp>
+#include <boost/intrusive/unordered_set.hpp>
+#include <boost/intrusive/set.hpp>
 
 #include "ten/task.hh"
 #include "ten/logging.hh"
@@ -22,6 +25,10 @@ void taskdumpf(FILE *of = stderr);
 
 class task::impl {
     friend class scheduler;
+    friend class run_queue;
+    friend void this_task::set_priority(task_priority);
+    friend task_priority this_task::get_priority();
+    friend class deadline;
     friend std::ostream &operator << (std::ostream &o, ptr<task::impl> t);
 private:
     static constexpr size_t namesize = 16;
@@ -36,15 +43,27 @@ private:
     // to get most used in the first cache line
     context _ctx;
     ptr<scheduler> _scheduler;
+    //! link in scheduler::_readyq
+    boost::intrusive::list_member_hook<> _ready_hook;
+    //! link in scheduler::_readyq when ordered by deadline
+    boost::intrusive::set_member_hook<> _edf_hook;
+    task_priority _priority = task_priority::normal;
+    //! class of the run_queue entry, set when it is linked
+    uint8_t _ready_class = 0;
+    //! earliest deadline the task holds, max if none
+    kernel::time_point _deadline = kernel::time_point::max();
     std::exception_ptr _exception;
     uint64_t _cancel_points;
     struct auxinfo { char name[namesize]; char state[statesize]; };
-    std::unique_ptr<auxinfo> _aux;
+    //! name is formatted on first use, spawning stays cheap
+    mutable auxinfo _aux;
 #ifdef TEN_TASK_TRACE
     saved_backtrace _trace;
 #endif
-    const uint64_t _id;
-    std::function<void ()> _fn;
+    uint64_t _id;
+    //! callable placed on the stack by create(), null once it has run
+    const task::fn_ops *_fn_ops;
+    void *_fn;
     std::atomic<bool> _ready;
     std::atomic<bool> _canceled;
     struct joininfo {
@@ -52,17 +71,57 @@ private:
         ptr<task::impl> joiner;
     };
     synchronized<joininfo> _join;
+    //! link in scheduler::_user_tasks
+    boost::intrusive::list_member_hook<> _tasks_hook;
+    //! link in scheduler::_task_ids
+    boost::intrusive::unordered_set_member_hook<> _id_hook;
+    //! when it was last readied, and when it last started running
+    kernel::time_point _ready_at;
+    kernel::time_point _run_start;
+    //! total time spent running and times swapped in
+    kernel::duration _run_time{0};
+    uint64_t _runs = 0;
+    //! rounded size of the stack holding this task, 0 for the thread's own
+    size_t _stack_size = 0;
+    //! the scheduler's reference, keeps the task alive while attached.
+    // also holds unattached tasks, see park()
+    std::shared_ptr<task::impl> _self;
 public:
+    //! task for the thread's own stack
     impl();
-    impl(std::function<void ()> f, size_t stacksize);
+    //! task running fn on the stack below it, see create()
+    impl(const task::fn_ops &ops, void *fn, size_t stacksize);
+    ~impl();
+
+    //! make a task with its control block and callable at the top of
+    // a stack from stack_allocator, so spawning allocates nothing else
+    static std::shared_ptr<impl> create(const task::fn_ops &ops, void *arg, size_t stacksize);
+
+    template <class Function>
+        static std::shared_ptr<impl> create(Function &&f, size_t stacksize) {
+            typename task::fn_ops_for<Function>::ref r{std::forward<Function>(f)};
+            return create(task::fn_ops_for<Function>::ops, &r, stacksize);
+        }
+
+    //! destroy a task made by create() and free its stack
+    static void destroy(impl *t) noexcept;
+    //! reset an exited task so create() can reuse it and its stack
+    void recycle() noexcept;
+    //! madvise away deep pages of a recycled task's stack
+    void trim_stack() noexcept;
+
+    //! keep an unattached task alive through _self, returns a raw pointer
+    // that can be passed around until unpark()
+    static task::impl *park(std::shared_ptr<impl> t);
+    std::shared_ptr<impl> unpark();
 
     void setname(const char *fmt, ...) __attribute__((format (printf, 2, 3)));
     void vsetname(const char *fmt, va_list arg);
     void setstate(const char *fmt, ...) __attribute__((format (printf, 2, 3)));
     void vsetstate(const char *fmt, va_list arg);
 
-    const char *getname() const { return _aux->name; }
-    const char *getstate() const { return _aux->state; }
+    const char *getname() const;
+    const char *getstate() const { return _aux.state; }
 
     void ready(bool front=false);
     void ready_for_io();
@@ -76,10 +135,12 @@ public:
     bool cancelable() const;
 
     uint64_t get_id() const { return _id; }
+    size_t stack_size() const { return _stack_size; }
 
     void join() noexcept;
 private:
     static void trampoline(intptr_t arg);
+    void reuse(const task::fn_ops &ops, void *fn, size_t stacksize);
     void check_canceled();
 };
 
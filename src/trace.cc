@@ -0,0 +1,236 @@
+#include "trace.hh"
+#include "ten/thread_local.hh"
+#include "ten/task/kernel.hh"
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <unordered_set>
+#include <unordered_map>
+#include <string>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+namespace ten {
+namespace trace {
+
+std::atomic<bool> on{false};
+
+namespace {
+
+struct event_rec {
+    uint64_t ts; // steady clock nanoseconds
+    uint64_t task;
+    uint64_t arg;
+    event_type type;
+};
+
+//! one ring entry. seq is odd while the writer fills it and 2*(i+1)
+// once it holds event i, so a reader can tell a torn or lapped copy
+struct slot {
+    std::atomic<uint64_t> seq{0};
+    std::atomic<uint64_t> ts{0};
+    std::atomic<uint64_t> task{0};
+    std::atomic<uint64_t> arg{0};
+    std::atomic<event_type> type{event_type::spawn};
+};
+
+//! single writer ring, readers copy and drop what was overwritten meanwhile
+struct ring {
+    const pid_t tid;
+    const size_t mask;
+    std::unique_ptr<slot[]> events;
+    std::atomic<uint64_t> head{0};
+    //! events before this were dropped by clear()
+    std::atomic<uint64_t> cleared{0};
+    std::atomic<bool> exited{false};
+
+    ring(size_t capacity)
+        : tid(syscall(SYS_gettid)), mask(capacity - 1),
+        events(new slot[capacity]) {}
+
+    void push(event_type type, uint64_t task, uint64_t arg) {
+        const uint64_t h = head.load(std::memory_order_relaxed);
+        slot &e = events[h & mask];
+        e.seq.store(2 * h + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        e.ts.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                kernel::clock::now().time_since_epoch()).count(), std::memory_order_relaxed);
+        e.task.store(task, std::memory_order_relaxed);
+        e.arg.store(arg, std::memory_order_relaxed);
+        e.type.store(type, std::memory_order_relaxed);
+        e.seq.store(2 * (h + 1), std::memory_order_release);
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    //! copy event i, false if it is being written or was overwritten
+    bool read(uint64_t i, event_rec &rec) const {
+        const slot &e = events[i & mask];
+        const uint64_t seq = e.seq.load(std::memory_order_acquire);
+        if (seq != 2 * (i + 1)) return false;
+        rec.ts = e.ts.load(std::memory_order_relaxed);
+        rec.task = e.task.load(std::memory_order_relaxed);
+        rec.arg = e.arg.load(std::memory_order_relaxed);
+        rec.type = e.type.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return e.seq.load(std::memory_order_relaxed) == seq;
+    }
+
+    void snapshot(std::vector<std::pair<pid_t, event_rec>> &out) const {
+        const size_t cap = mask + 1;
+        const uint64_t end = head.load(std::memory_order_acquire);
+        uint64_t start = std::max(end > cap ? end - cap : 0, cleared.load());
+        if (start > end) start = end;
+        // events the writer laps while we copy fail their seq check
+        event_rec rec;
+        for (uint64_t i = start; i < end; ++i) {
+            if (read(i, rec)) {
+                out.emplace_back(tid, rec);
+            }
+        }
+    }
+};
+
+std::atomic<size_t> ring_size{1 << 16};
+std::mutex registry_mutex;
+std::vector<std::shared_ptr<ring>> registry;
+
+//! marks this thread's ring exited when the thread goes away
+struct ring_holder {
+    std::shared_ptr<ring> r;
+    ~ring_holder() {
+        if (r) r->exited = true;
+    }
+};
+
+struct ring_tag {};
+thread_cached<ring_tag, ring_holder> this_ring;
+
+ring &get_ring() {
+    ring_holder &h = *this_ring.get();
+    if (!h.r) {
+        h.r = std::make_shared<ring>(ring_size.load());
+        std::lock_guard<std::mutex> lock{registry_mutex};
+        registry.push_back(h.r);
+    }
+    return *h.r;
+}
+
+void write_event(std::ostream &o, bool &first, const char *ph, pid_t pid, pid_t tid,
+        uint64_t ts, const std::string &name, const std::string &extra = "")
+{
+    if (!first) o << ",\n";
+    first = false;
+    // chrome wants microseconds
+    o << "{\"ph\":\"" << ph << "\",\"pid\":" << pid << ",\"tid\":" << tid
+      << ",\"ts\":" << ts / 1000 << "." << (ts % 1000) / 100 << (ts % 100) / 10 << ts % 10
+      << ",\"name\":\"" << name << "\"" << extra << "}";
+}
+
+std::string task_name(uint64_t task) {
+    return "task " + std::to_string(task);
+}
+
+const char *event_name(event_type t) {
+    switch (t) {
+        case event_type::spawn: return "spawn";
+        case event_type::swap_in: return "swap_in";
+        case event_type::swap_out: return "swap_out";
+        case event_type::ready_remote: return "ready_remote";
+        case event_type::io_wait: return "io_wait";
+        case event_type::alarm: return "alarm";
+        case event_type::exit: return "exit";
+    }
+    return "unknown";
+}
+
+} // anon
+
+void record(event_type type, uint64_t task, uint64_t arg) {
+    get_ring().push(type, task, arg);
+}
+
+void enable(size_t events_per_thread) {
+    size_t n = 1;
+    while (n < events_per_thread) n <<= 1;
+    ring_size = n;
+    on = true;
+}
+
+void disable() {
+    on = false;
+}
+
+bool enabled() {
+    return on.load();
+}
+
+void clear() {
+    std::lock_guard<std::mutex> lock{registry_mutex};
+    registry.erase(std::remove_if(registry.begin(), registry.end(),
+                [](const std::shared_ptr<ring> &r) { return r->exited.load(); }),
+            registry.end());
+    for (auto &r : registry) {
+        // the writer owns head, so just hide what is there now
+        r->cleared = r->head.load();
+    }
+}
+
+void dump_chrome_json(std::ostream &o) {
+    std::vector<std::pair<pid_t, event_rec>> events;
+    {
+        std::lock_guard<std::mutex> lock{registry_mutex};
+        for (auto &r : registry) {
+            r->snapshot(events);
+        }
+    }
+    std::stable_sort(events.begin(), events.end(),
+            [](const std::pair<pid_t, event_rec> &a, const std::pair<pid_t, event_rec> &b) {
+                return a.second.ts < b.second.ts;
+            });
+
+    const pid_t pid = getpid();
+    bool first = true;
+    // task running on each thread, to drop unmatched swap_outs
+    // at the start of a ring that wrapped
+    std::unordered_map<pid_t, uint64_t> running;
+    // tasks readied from another thread whose flow arrow is still open
+    std::unordered_set<uint64_t> wakeups;
+    o << "{\"traceEvents\":[\n";
+    for (const auto &pe : events) {
+        const pid_t tid = pe.first;
+        const event_rec &e = pe.second;
+        switch (e.type) {
+            case event_type::swap_in:
+                write_event(o, first, "B", pid, tid, e.ts, task_name(e.task));
+                running[tid] = e.task;
+                if (wakeups.erase(e.task)) {
+                    write_event(o, first, "f", pid, tid, e.ts, "wakeup",
+                            ",\"cat\":\"wakeup\",\"bp\":\"e\",\"id\":" + std::to_string(e.task));
+                }
+                break;
+            case event_type::swap_out: {
+                auto i = running.find(tid);
+                if (i != running.end() && i->second == e.task) {
+                    write_event(o, first, "E", pid, tid, e.ts, task_name(e.task));
+                    running.erase(i);
+                }
+                break;
+            }
+            case event_type::ready_remote:
+                write_event(o, first, "s", pid, tid, e.ts, "wakeup",
+                        ",\"cat\":\"wakeup\",\"id\":" + std::to_string(e.task));
+                wakeups.insert(e.task);
+                break;
+            default:
+                write_event(o, first, "i", pid, tid, e.ts, event_name(e.type),
+                        ",\"s\":\"t\",\"cat\":\"sched\",\"args\":{\"task\":"
+                        + std::to_string(e.task) + ",\"arg\":" + std::to_string(e.arg) + "}");
+                break;
+        }
+    }
+    o << "\n]}\n";
+}
+
+} // trace
+} // ten
@@ -0,0 +1,35 @@
+#ifndef LIBTEN_TRACE_PRIVATE_HH
+#define LIBTEN_TRACE_PRIVATE_HH
+
+#include "ten/task/trace.hh"
+#include <atomic>
+#include <cstdint>
+
+namespace ten {
+namespace trace {
+
+enum class event_type : uint8_t {
+    spawn,        //!< arg is the spawning task
+    swap_in,
+    swap_out,
+    ready_remote, //!< readied by a task in another thread
+    io_wait,      //!< arg is the fd, or ~0 for several
+    alarm,
+    exit,
+};
+
+extern std::atomic<bool> on;
+
+void record(event_type type, uint64_t task, uint64_t arg);
+
+//! record an event in this thread's ring if tracing is on
+inline void event(event_type type, uint64_t task, uint64_t arg = 0) {
+    if (on.load(std::memory_order_relaxed)) {
+        record(type, task, arg);
+    }
+}
+
+} // trace
+} // ten
+
+#endif
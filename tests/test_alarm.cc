@@ -0,0 +1,121 @@
+#include "gtest/gtest.h"
+#include "../src/alarm.hh"
+#include <vector>
+#include <memory>
+#include <random>
+
+using namespace ten;
+using namespace std::chrono;
+
+struct fake_clock {
+    typedef milliseconds duration;
+    typedef duration::rep rep;
+    typedef duration::period period;
+    typedef std::chrono::time_point<fake_clock> time_point;
+    static constexpr bool is_steady = true;
+
+    static time_point current;
+    static time_point now() { return current; }
+};
+
+fake_clock::time_point fake_clock::current{hours{1}};
+
+typedef alarm_clock<int, fake_clock> test_clock;
+
+static std::vector<int> advance(test_clock &c, milliseconds ms) {
+    std::vector<int> fired;
+    fake_clock::current += ms;
+    c.tick(fake_clock::now(), [&](int v, std::exception_ptr) {
+        fired.push_back(v);
+    });
+    return fired;
+}
+
+TEST(AlarmClock, FireInOrder) {
+    test_clock c;
+    auto start = fake_clock::now();
+    test_clock::scoped_alarm a{c, 1, start + milliseconds{10}};
+    test_clock::scoped_alarm b{c, 2, start + milliseconds{5}};
+    test_clock::scoped_alarm d{c, 3, start + milliseconds{300}};
+    EXPECT_EQ(start + milliseconds{5}, *c.when());
+    EXPECT_TRUE(advance(c, milliseconds{4}).empty());
+    EXPECT_EQ(std::vector<int>{2}, advance(c, milliseconds{1}));
+    EXPECT_EQ(std::vector<int>{1}, advance(c, milliseconds{10}));
+    EXPECT_FALSE(c.empty());
+    EXPECT_EQ(std::vector<int>{3}, advance(c, milliseconds{1000}));
+    EXPECT_TRUE(c.empty());
+    EXPECT_FALSE(c.when());
+}
+
+TEST(AlarmClock, Cancel) {
+    test_clock c;
+    auto start = fake_clock::now();
+    test_clock::scoped_alarm a{c, 1, start + milliseconds{10}};
+    {
+        test_clock::scoped_alarm b{c, 2, start + milliseconds{5}};
+    }
+    EXPECT_EQ(start + milliseconds{10}, *c.when());
+    a.cancel();
+    EXPECT_TRUE(c.empty());
+    EXPECT_TRUE(advance(c, milliseconds{20}).empty());
+}
+
+TEST(AlarmClock, Move) {
+    test_clock c;
+    auto start = fake_clock::now();
+    test_clock::scoped_alarm a{c, 1, start + milliseconds{10}};
+    test_clock::scoped_alarm b{std::move(a)};
+    a.cancel();
+    EXPECT_FALSE(c.empty());
+    test_clock::scoped_alarm d;
+    d = std::move(b);
+    EXPECT_EQ(std::vector<int>{1}, advance(c, milliseconds{10}));
+}
+
+TEST(AlarmClock, WhenIsNotLate) {
+    // far alarms may report an earlier when(), never a later one
+    test_clock c;
+    auto start = fake_clock::now();
+    test_clock::scoped_alarm a{c, 1, start + seconds{30}};
+    ASSERT_TRUE((bool)c.when());
+    EXPECT_LE(*c.when(), start + seconds{30});
+    for (int i=0; i<100 && *c.when() < start + seconds{30}; ++i) {
+        EXPECT_TRUE(advance(c, *c.when() - fake_clock::now()).empty());
+    }
+    EXPECT_EQ(start + seconds{30}, *c.when());
+    EXPECT_EQ(std::vector<int>{1}, advance(c, *c.when() - fake_clock::now()));
+}
+
+TEST(AlarmClock, Random) {
+    test_clock c;
+    std::mt19937 rng{42};
+    auto start = fake_clock::now();
+    std::vector<std::unique_ptr<test_clock::scoped_alarm>> alarms;
+    std::vector<fake_clock::time_point> whens;
+    // spread across every level, including beyond the wheel
+    const milliseconds ranges[] = {
+        milliseconds{200}, seconds{10}, minutes{10}, hours{10}, hours{30}};
+    for (int i=0; i<2000; ++i) {
+        milliseconds r = ranges[i % 5];
+        auto when = start + milliseconds{rng() % r.count()};
+        whens.push_back(when);
+        alarms.emplace_back(new test_clock::scoped_alarm{c, i, when});
+    }
+    // cancel every third
+    for (int i=0; i<2000; i+=3) {
+        alarms[i]->cancel();
+    }
+    size_t nfired = 0;
+    while (!c.empty()) {
+        ASSERT_TRUE((bool)c.when());
+        auto next = std::max(*c.when(), fake_clock::now());
+        fake_clock::current = next;
+        c.tick(fake_clock::now(), [&](int v, std::exception_ptr) {
+            EXPECT_NE(0, v % 3);
+            // stepping by when() lands exactly on each alarm
+            EXPECT_EQ(whens[v], fake_clock::now());
+            ++nfired;
+        });
+    }
+    EXPECT_EQ(2000u - 667u, nfired);
+}
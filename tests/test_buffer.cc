@@ -1,5 +1,7 @@
 #include "gtest/gtest.h"
 #include "ten/buffer.hh"
+#include "ten/buffer_pipe.hh"
+#include <set>
 
 using namespace ten;
 
@@ -42,3 +44,44 @@ TEST(Buffer, Test2) {
     }
 }
 
+
+TEST(BufferPipe, Stream) {
+    task::main([] {
+        buffer_pipe pipe{4, 64};
+        const int total = 100000;
+        std::set<buffer *> seen;
+        auto writer = task::spawn([=]() mutable {
+            int n = 0;
+            while (n < total) {
+                auto seg = pipe.get();
+                EXPECT_EQ(0u, seg->size());
+                uint32_t len = std::min<uint32_t>(seg->available(), total - n);
+                for (uint32_t i = 0; i < len; ++i) {
+                    seg->back()[i] = char(n + i);
+                }
+                seg->commit(len);
+                n += len;
+                pipe.put(std::move(seg));
+            }
+            pipe.close();
+        });
+        int n = 0;
+        try {
+            for (;;) {
+                auto seg = pipe.next();
+                seen.insert(seg.get());
+                for (uint32_t i = 0; i < seg->size(); ++i) {
+                    ASSERT_EQ(char(n + i), seg->front()[i]);
+                }
+                n += seg->size();
+                pipe.release(std::move(seg));
+            }
+        } catch (channel_closed_error &) {
+        }
+        writer.join();
+        EXPECT_EQ(total, n);
+        // the same few buffers went round and round
+        EXPECT_LE(seen.size(), 4u);
+        EXPECT_THROW(pipe.get(), channel_closed_error);
+    });
+}
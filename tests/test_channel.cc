@@ -2,6 +2,9 @@
 #include "ten/descriptors.hh"
 #include "ten/semaphore.hh"
 #include "ten/channel.hh"
+#include "ten/bounded_channel.hh"
+#include "ten/alt.hh"
+#include "ten/thread_guard.hh"
 
 using namespace ten;
 
@@ -223,3 +226,282 @@ TEST(Channel, Close) {
     EXPECT_EQ(closed, 3);
 }
 
+
+TEST(Channel, UnbufferedHandoff) {
+    task::main([] {
+        channel<int> c;
+        int got = 0;
+        auto receiver = task::spawn([=, &got]() mutable {
+            got = c.recv();
+        });
+        this_task::yield();
+        // the receiver is waiting, so send hands the item over
+        // without waiting and the receiver runs next
+        c.send(42);
+        EXPECT_TRUE(c.empty());
+        this_task::yield();
+        EXPECT_EQ(42, got);
+        receiver.join();
+
+        // a receiver that gave up doesn't take the next item
+        auto quitter = task::spawn([=]() mutable {
+            deadline dl{std::chrono::milliseconds{1}};
+            EXPECT_THROW(c.recv(), deadline_reached);
+        });
+        quitter.join();
+        receiver = task::spawn([=, &got]() mutable {
+            got = c.recv();
+        });
+        c.send(7);
+        receiver.join();
+        EXPECT_EQ(7, got);
+    });
+}
+
+TEST(Channel, UnbufferedHandoffInterrupted) {
+    task::main([] {
+        channel<int> c;
+        bool interrupted = false;
+        auto receiver = task::spawn([=, &interrupted]() mutable {
+            try {
+                c.recv();
+            } catch (task_interrupted &) {
+                interrupted = true;
+            }
+        });
+        this_task::yield();
+        // hand 1 over, then interrupt the receiver before it runs
+        c.send(1);
+        receiver.cancel();
+        // 2 gets queued before the receiver gives 1 back
+        auto sender = task::spawn([=]() mutable {
+            c.send(2);
+        });
+        receiver.join();
+        EXPECT_TRUE(interrupted);
+        EXPECT_EQ(1, c.recv());
+        EXPECT_EQ(2, c.recv());
+        sender.join();
+        EXPECT_TRUE(c.empty());
+    });
+}
+
+TEST(Channel, Batch) {
+    task::main([] {
+        channel<int> c{8};
+        std::vector<int> in{1, 2, 3, 4, 5};
+        EXPECT_EQ(5u, c.send_n(in));
+        std::vector<int> out;
+        EXPECT_EQ(3u, c.recv_up_to(std::back_inserter(out), 3));
+        EXPECT_EQ((std::vector<int>{1, 2, 3}), out);
+        EXPECT_EQ(2u, c.drain(std::back_inserter(out)));
+        EXPECT_EQ(0u, c.drain(std::back_inserter(out)));
+        EXPECT_EQ(in, out);
+
+        // more than fits, the receiver makes room
+        std::vector<int> many(100);
+        for (int i=0; i<100; ++i) many[i] = i;
+        std::vector<int> got;
+        auto receiver = task::spawn([=, &got]() mutable {
+            while (got.size() < 100) {
+                c.recv_up_to(std::back_inserter(got), 16);
+            }
+        });
+        EXPECT_EQ(100u, c.send_n(many.begin(), many.end()));
+        receiver.join();
+        EXPECT_EQ(many, got);
+
+        c.close();
+        EXPECT_THROW(c.recv_up_to(std::back_inserter(got), 1), channel_closed_error);
+        EXPECT_THROW(c.send_n(many), channel_closed_error);
+
+        // closed partway through, send_n reports what got in
+        channel<int> partial{4};
+        size_t sent = 0;
+        auto sender = task::spawn([=, &sent]() mutable {
+            sent = partial.send_n(many);
+        });
+        this_task::yield();
+        partial.close();
+        sender.join();
+        EXPECT_EQ(4u, sent);
+        EXPECT_EQ(4u, partial.unread());
+    });
+}
+
+TEST(BoundedChannel, TrySendRecv) {
+    task::main([] {
+        bounded_channel<int, 2> c;
+        EXPECT_TRUE(c.try_send(1));
+        EXPECT_TRUE(c.try_send(2));
+        EXPECT_FALSE(c.try_send(3));
+        int v = 0;
+        EXPECT_TRUE(c.try_recv(v));
+        EXPECT_EQ(1, v);
+        EXPECT_EQ(2, c.recv());
+        EXPECT_FALSE(c.try_recv(v));
+    });
+}
+
+TEST(BoundedChannel, Close) {
+    task::main([] {
+        bounded_channel<int, 4> c;
+        c.send(1);
+        c.send(2);
+        bool recv_closed = false;
+        auto waiter = task::spawn([&] {
+            try {
+                c.recv();
+                c.recv();
+                // waits until closed
+                c.recv();
+            } catch (channel_closed_error &) {
+                recv_closed = true;
+            }
+        });
+        this_task::yield();
+        c.close();
+        waiter.join();
+        EXPECT_TRUE(recv_closed);
+        EXPECT_TRUE(c.is_closed());
+        EXPECT_THROW(c.send(3), channel_closed_error);
+    });
+}
+
+TEST(BoundedChannel, Pipeline) {
+    const int count = 100000;
+    bounded_channel<std::unique_ptr<int>, 16> a;
+    bounded_channel<std::unique_ptr<int>, 16> b;
+    long sum = 0;
+    task::main([&] {
+        std::vector<thread_guard> threads;
+        threads.emplace_back(task::spawn_thread([=]() mutable {
+            for (int i=0; i<count; ++i) {
+                a.send(std::unique_ptr<int>(new int(i)));
+            }
+            a.close();
+        }));
+        threads.emplace_back(task::spawn_thread([=]() mutable {
+            try {
+                for (;;) b.send(a.recv());
+            } catch (channel_closed_error &) {
+                b.close();
+            }
+        }));
+        try {
+            for (;;) sum += *b.recv();
+        } catch (channel_closed_error &) {
+        }
+    });
+    EXPECT_EQ(long(count) * (count - 1) / 2, sum);
+}
+
+TEST(Alt, RecvFromEither) {
+    task::main([] {
+        channel<int> a{4};
+        channel<std::string> b{4};
+        int ai = 0;
+        std::string bs;
+        alt sel;
+        EXPECT_EQ(0, sel.recv(a, ai));
+        EXPECT_EQ(1, sel.recv(b, bs));
+        EXPECT_EQ(-1, sel.try_wait());
+        auto sender = task::spawn([=]() mutable {
+            this_task::yield();
+            b.send("hi");
+            this_task::yield();
+            a.send(42);
+        });
+        EXPECT_EQ(1, sel.wait());
+        EXPECT_EQ("hi", bs);
+        EXPECT_EQ(0, sel.wait());
+        EXPECT_EQ(42, ai);
+        sender.join();
+        EXPECT_TRUE(a.empty());
+        EXPECT_TRUE(b.empty());
+    });
+}
+
+TEST(Alt, TimeoutAndClose) {
+    task::main([] {
+        channel<int> requests{4};
+        channel<int> shutdown;
+        int req = 0;
+        int sig = 0;
+        alt sel;
+        sel.recv(requests, req);
+        sel.recv(shutdown, sig);
+        EXPECT_EQ(-1, sel.wait(std::chrono::milliseconds{5}));
+        {
+            // the caller's own deadline is not the alt timing out
+            deadline dl{std::chrono::milliseconds{5}};
+            EXPECT_THROW(sel.wait(std::chrono::milliseconds{1000}), deadline_reached);
+        }
+        {
+            deadline dl{std::chrono::milliseconds{1000}};
+            EXPECT_EQ(-1, sel.wait(std::chrono::milliseconds{5}));
+        }
+        auto closer = task::spawn([=]() mutable {
+            this_task::sleep_for(std::chrono::milliseconds{2});
+            shutdown.close();
+        });
+        EXPECT_EQ(1, sel.wait(std::chrono::milliseconds{1000}));
+        EXPECT_TRUE(sel.closed());
+        closer.join();
+    });
+}
+
+TEST(Alt, SendWhenRoom) {
+    task::main([] {
+        channel<int> full{2};
+        channel<int> in{2};
+        full.send(1);
+        full.send(2);
+        int got = 0;
+        alt sel;
+        EXPECT_EQ(0, sel.send(full, 3));
+        EXPECT_EQ(1, sel.recv(in, got));
+        auto drainer = task::spawn([=]() mutable {
+            this_task::yield();
+            full.recv();
+        });
+        EXPECT_EQ(0, sel.wait());
+        EXPECT_FALSE(sel.closed());
+        drainer.join();
+        EXPECT_EQ(2u, full.unread());
+    });
+}
+
+TEST(Alt, FanInAcrossThreads) {
+    const int per_sender = 10000;
+    std::vector<channel<int>> chans;
+    for (int i=0; i<4; ++i) chans.emplace_back(8);
+    long sum = 0;
+    task::main([&] {
+        std::vector<thread_guard> threads;
+        for (auto c : chans) {
+            threads.emplace_back(task::spawn_thread([=]() mutable {
+                for (int i=0; i<per_sender; ++i) c.send(1);
+                c.close();
+            }));
+        }
+        std::vector<int> vals(chans.size());
+        alt sel;
+        for (size_t i=0; i<chans.size(); ++i) sel.recv(chans[i], vals[i]);
+        size_t open = chans.size();
+        std::vector<bool> done(chans.size());
+        while (open) {
+            int i = sel.wait();
+            ASSERT_GE(i, 0);
+            if (sel.closed()) {
+                if (!done[i]) {
+                    done[i] = true;
+                    --open;
+                }
+            } else {
+                sum += vals[i];
+            }
+        }
+    });
+    EXPECT_EQ(4L * per_sender, sum);
+}
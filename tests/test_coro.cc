@@ -0,0 +1,158 @@
+#include "gtest/gtest.h"
+#include "ten/task.hh"
+#include "ten/task/coro.hh"
+#include "ten/descriptors.hh"
+#include "ten/channel.hh"
+#include "ten/thread_guard.hh"
+#include <atomic>
+
+using namespace ten;
+using namespace std::chrono;
+
+TEST(Coro, SleepAndYield) {
+    int count = 0;
+    task::main([&] {
+        for (int i=0; i<1000; ++i) {
+            coro::spawn([](int &count) -> coro::task<> {
+                co_await coro::sleep_for(milliseconds{1});
+                co_await coro::yield();
+                ++count;
+            }(count));
+        }
+        // task::main waits for the coroutines too
+    });
+    EXPECT_EQ(1000, count);
+}
+
+TEST(Coro, TasksStillRun) {
+    std::vector<int> order;
+    task::main([&] {
+        coro::spawn([](std::vector<int> &order) -> coro::task<> {
+            co_await coro::sleep_for(milliseconds{20});
+            order.push_back(2);
+        }(order));
+        // the runner sleeping on its alarm does not block tasks
+        task::spawn([&] {
+            this_task::sleep_for(milliseconds{5});
+            order.push_back(1);
+        }).join();
+    });
+    ASSERT_EQ(2u, order.size());
+    EXPECT_EQ(1, order[0]);
+    EXPECT_EQ(2, order[1]);
+}
+
+static coro::task<int> add_later(int a, int b) {
+    co_await coro::yield();
+    co_return a + b;
+}
+
+static coro::task<int> throw_later() {
+    co_await coro::yield();
+    throw std::runtime_error("later");
+}
+
+TEST(Coro, AwaitResult) {
+    int sum = 0;
+    bool caught = false;
+    task::main([&] {
+        coro::spawn([](int &sum, bool &caught) -> coro::task<> {
+            sum = co_await add_later(1, 2);
+            sum += co_await add_later(sum, 4);
+            try {
+                co_await throw_later();
+            } catch (std::runtime_error &e) {
+                caught = true;
+            }
+        }(sum, caught));
+    });
+    EXPECT_EQ(10, sum);
+    EXPECT_TRUE(caught);
+}
+
+TEST(Coro, NetRecvSend) {
+    std::string got;
+    ssize_t timeout_nr = 0;
+    int timeout_errno = 0;
+    task::main([&] {
+        int sv[2];
+        ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv));
+        socket_fd a{sv[0]};
+        socket_fd b{sv[1]};
+        coro::spawn([](int fd, std::string &got) -> coro::task<> {
+            char buf[64];
+            for (;;) {
+                ssize_t nr = co_await coro::netrecv(fd, buf, sizeof(buf));
+                if (nr <= 0) break;
+                got.append(buf, nr);
+                if (got.size() >= 10) break;
+            }
+        }(b.fd, got));
+        coro::spawn([](int fd) -> coro::task<> {
+            co_await coro::sleep_for(milliseconds{5});
+            co_await coro::netsend(fd, "hello", 5);
+            co_await coro::sleep_for(milliseconds{5});
+            co_await coro::netsend(fd, "world", 5);
+        }(a.fd));
+        // nothing sent this way, so this times out
+        coro::spawn([](int fd, ssize_t &nr, int &err) -> coro::task<> {
+            char c;
+            nr = co_await coro::netrecv(fd, &c, 1, 0, milliseconds{10});
+            err = errno;
+        }(a.fd, timeout_nr, timeout_errno));
+        this_task::sleep_for(milliseconds{50});
+    });
+    EXPECT_EQ("helloworld", got);
+    EXPECT_EQ(-1, timeout_nr);
+    EXPECT_EQ(ETIMEDOUT, timeout_errno);
+}
+
+TEST(Coro, Channels) {
+    int sum = 0;
+    bool closed = false;
+    task::main([&] {
+        channel<int> in{4};
+        channel<int> out;
+        coro::spawn([](channel<int> in, channel<int> out, bool &closed) -> coro::task<> {
+            try {
+                for (;;) {
+                    int v = co_await coro::recv(in);
+                    co_await coro::send(out, v * 2);
+                }
+            } catch (channel_closed_error &) {
+                closed = true;
+            }
+            out.close();
+        }(in, out, closed));
+        // woken from another thread
+        thread_guard sender{task::spawn_thread([=]() mutable {
+            for (int i=1; i<=100; ++i) {
+                in.send(std::move(i));
+            }
+            in.close();
+        })};
+        try {
+            for (;;) sum += out.recv();
+        } catch (channel_closed_error &) {
+        }
+    });
+    EXPECT_EQ(2 * 5050, sum);
+    EXPECT_TRUE(closed);
+}
+
+TEST(Coro, BlockingThrows) {
+    bool threw = false;
+    task::main([&] {
+        channel<int> c;
+        coro::spawn([](channel<int> c, bool &threw) -> coro::task<> {
+            try {
+                // would stall every coroutine on the thread
+                c.recv();
+            } catch (errorx &) {
+                threw = true;
+            }
+            co_return;
+        }(c, threw));
+    });
+    EXPECT_TRUE(threw);
+}
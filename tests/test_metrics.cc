@@ -148,3 +148,20 @@ TEST(Metrics, Interval) {
         bg.join();
     });
 }
+
+TEST(Metrics, Scheduler) {
+    task::main([] {
+        using namespace metrics;
+        record_scheduler();
+        auto t = task::spawn([] {
+            for (int i=0; i<10; ++i) {
+                this_task::yield();
+            }
+        });
+        t.join();
+        record_scheduler();
+        auto mg = global.aggregate();
+        EXPECT_LE(10, value<counter>(mg, "ten.sched.runs.normal"));
+        EXPECT_LT(0, value<timer>(mg, "ten.sched.run_time").count());
+    });
+}
@@ -4,6 +4,7 @@
 #include "ten/http/client.hh"
 #include "ten/channel.hh"
 #include <chrono>
+#include <thread>
 
 using namespace ten;
 using namespace std::chrono;
@@ -26,6 +27,15 @@ TEST(Net, SocketDial) {
         task::spawn(dial_google);
     });
 }
+TEST(Net, EdgeSocketOutlivesScheduler) {
+    netsock s;
+    task::main([&] {
+        s = netsock{AF_UNIX, SOCK_STREAM};
+        s.set_edge_triggered();
+    });
+    // destroyed on a thread with no scheduler to unregister from
+    std::thread([](netsock) {}, std::move(s)).join();
+}
 
 static void http_callback(http_exchange &ex) {
     ex.resp = { HTTP_OK, {}, "Hello World" };
@@ -0,0 +1,107 @@
+#include "gtest/gtest.h"
+#include "ten/task/proc_group.hh"
+#include "ten/synchronized.hh"
+#include "ten/task.hh"
+#include <thread>
+#include <set>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+using namespace ten;
+using namespace std::chrono;
+
+TEST(ProcGroup, RunsAll) {
+    std::atomic<size_t> count{0};
+    task::main([&] {
+        proc_group group{4};
+        EXPECT_EQ(4u, group.size());
+        for (int i=0; i<1000; ++i) {
+            group.spawn([&] {
+                this_task::yield();
+                ++count;
+            });
+        }
+    });
+    EXPECT_EQ(1000u, count);
+}
+
+static void spin_for(microseconds us) {
+    auto end = steady_clock::now() + us;
+    while (steady_clock::now() < end) {}
+}
+
+TEST(ProcGroup, Steal) {
+    std::atomic<size_t> count{0};
+    synchronized<std::set<std::thread::id>> ran_on;
+    task::main([&] {
+        proc_group group{4};
+        // all the work is spawned from one group thread,
+        // so the others only get it by stealing
+        group.spawn([&] {
+            for (int i=0; i<200; ++i) {
+                group.spawn([&] {
+                    spin_for(microseconds{200});
+                    ran_on([](std::set<std::thread::id> &s) {
+                        s.insert(std::this_thread::get_id());
+                    });
+                    ++count;
+                });
+            }
+        });
+    });
+    EXPECT_EQ(200u, count);
+    ran_on([](const std::set<std::thread::id> &s) {
+        EXPECT_GT(s.size(), 1u);
+    });
+}
+
+TEST(ProcGroup, SpawnOn) {
+    const size_t n = 4;
+    std::vector<std::set<std::thread::id>> ran_on(n);
+    std::mutex mutex;
+    task::main([&] {
+        proc_group group{n};
+        for (int k=0; k<50; ++k) {
+            for (size_t i=0; i<n; ++i) {
+                group.spawn_on(i, [&, i] {
+                    // pinned tasks are never stolen, even when their thread is busy
+                    spin_for(microseconds{50});
+                    std::lock_guard<std::mutex> lock{mutex};
+                    ran_on[i].insert(std::this_thread::get_id());
+                });
+            }
+        }
+    });
+    std::set<std::thread::id> all;
+    for (auto &s : ran_on) {
+        EXPECT_EQ(1u, s.size());
+        all.insert(s.begin(), s.end());
+    }
+    EXPECT_EQ(n, all.size());
+}
+
+TEST(ProcGroup, SpawnBalanced) {
+    std::atomic<size_t> count{0};
+    synchronized<std::set<std::thread::id>> ran_on;
+    task::main([&] {
+        proc_group group{4};
+        // keep one thread busy, balanced tasks should avoid it
+        group.spawn_on(0, [] {
+            spin_for(milliseconds{20});
+        });
+        for (int i=0; i<200; ++i) {
+            group.spawn_balanced([&] {
+                this_task::yield();
+                ran_on([](std::set<std::thread::id> &s) {
+                    s.insert(std::this_thread::get_id());
+                });
+                ++count;
+            });
+        }
+    });
+    EXPECT_EQ(200u, count);
+    ran_on([](const std::set<std::thread::id> &s) {
+        EXPECT_GT(s.size(), 1u);
+    });
+}
@@ -4,6 +4,8 @@
 #include "ten/synchronized.hh"
 #include "ten/thread_guard.hh"
 #include "ten/task/rendez.hh"
+#include "ten/task/shared_qutex.hh"
+#include "ten/task/semaphore.hh"
 
 using namespace ten;
 
@@ -61,3 +63,235 @@ TEST(Qutex, Synchronized) {
 
     EXPECT_EQ(*sync_view(s), "test2");
 }
+
+TEST(Qutex, TryLock) {
+    task::main([] {
+        qutex q;
+        EXPECT_TRUE(q.try_lock());
+        bool other = true;
+        task::spawn([&] {
+            other = q.try_lock();
+        }).join();
+        EXPECT_FALSE(other);
+        q.unlock();
+        EXPECT_TRUE(q.try_lock());
+        q.unlock();
+    });
+}
+
+TEST(Qutex, HandoffInOrder) {
+    task::main([] {
+        qutex q;
+        std::vector<int> order;
+        std::unique_lock<qutex> lk{q};
+        std::vector<task> waiters;
+        for (int i=0; i<5; ++i) {
+            waiters.emplace_back(task::spawn([&, i] {
+                std::lock_guard<qutex> l{q};
+                order.push_back(i);
+            }));
+            // let it queue up behind us
+            this_task::yield();
+        }
+        lk.unlock();
+        for (auto &t : waiters) {
+            t.join();
+        }
+        EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 4}), order);
+        // uncontended again
+        EXPECT_TRUE(q.try_lock());
+        q.unlock();
+    });
+}
+
+TEST(Qutex, ContendedAcrossThreads) {
+    task::main([] {
+        qutex q;
+        int count = 0;
+        std::vector<thread_guard> threads;
+        for (int i=0; i<4; ++i) {
+            threads.emplace_back(task::spawn_thread([&] {
+                for (int j=0; j<4; ++j) {
+                    task::spawn([&] {
+                        for (int k=0; k<500; ++k) {
+                            std::lock_guard<qutex> l{q};
+                            const int c = count;
+                            // hold the lock across a yield so others queue up
+                            if (k % 10 == 0) this_task::yield();
+                            count = c + 1;
+                        }
+                    });
+                }
+            }));
+        }
+        threads.clear();
+        EXPECT_EQ(4 * 4 * 500, count);
+        EXPECT_TRUE(q.try_lock());
+        q.unlock();
+    });
+}
+
+TEST(SharedQutex, ReadersShare) {
+    task::main([] {
+        shared_qutex q;
+        q.lock_shared();
+        bool other = false;
+        task::spawn([&] {
+            other = q.try_lock_shared();
+            if (other) q.unlock_shared();
+        }).join();
+        EXPECT_TRUE(other);
+        EXPECT_FALSE(q.try_lock());
+        q.unlock_shared();
+        EXPECT_TRUE(q.try_lock());
+        EXPECT_FALSE(q.try_lock_shared());
+        q.unlock();
+    });
+}
+
+TEST(SharedQutex, WriterPreference) {
+    task::main([] {
+        shared_qutex q;
+        std::vector<std::string> order;
+        q.lock_shared();
+        auto w = task::spawn([&] {
+            std::lock_guard<shared_qutex> lk{q};
+            order.push_back("w");
+        });
+        this_task::yield();
+        // writer is queued, so new readers wait behind it
+        EXPECT_FALSE(q.try_lock_shared());
+        auto r = task::spawn([&] {
+            q.lock_shared();
+            order.push_back("r");
+            q.unlock_shared();
+        });
+        this_task::yield();
+        EXPECT_TRUE(order.empty());
+        q.unlock_shared();
+        w.join();
+        r.join();
+        ASSERT_EQ(2u, order.size());
+        EXPECT_EQ("w", order[0]);
+        EXPECT_EQ("r", order[1]);
+    });
+}
+
+TEST(SharedQutex, ContendedAcrossThreads) {
+    task::main([] {
+        shared_qutex q;
+        int a = 0;
+        int b = 0;
+        std::atomic<int> torn{0};
+        std::vector<thread_guard> threads;
+        for (int id=0; id<4; ++id) {
+            threads.emplace_back(task::spawn_thread([&, id] {
+                for (int i=0; i<5000; ++i) {
+                    if ((i + id) % 8 == 0) {
+                        std::lock_guard<shared_qutex> lk{q};
+                        ++a;
+                        this_task::yield();
+                        ++b;
+                    } else {
+                        q.lock_shared();
+                        if (a != b) ++torn;
+                        this_task::yield();
+                        if (a != b) ++torn;
+                        q.unlock_shared();
+                    }
+                }
+            }));
+        }
+        threads.clear();
+        EXPECT_EQ(0, torn.load());
+        EXPECT_EQ(a, b);
+        EXPECT_EQ(4 * 5000 / 8, a);
+    });
+}
+
+TEST(TaskSemaphore, LimitsInFlight) {
+    task::main([] {
+        task_semaphore sem{2};
+        int in_flight = 0;
+        int most = 0;
+        std::vector<task> tasks;
+        for (int i=0; i<10; ++i) {
+            tasks.emplace_back(task::spawn([&] {
+                sem.acquire();
+                most = std::max(most, ++in_flight);
+                this_task::sleep_for(std::chrono::milliseconds{1});
+                --in_flight;
+                sem.release();
+            }));
+        }
+        for (auto &t : tasks) t.join();
+        EXPECT_EQ(2, most);
+        EXPECT_TRUE(sem.try_acquire());
+        EXPECT_TRUE(sem.try_acquire());
+        EXPECT_FALSE(sem.try_acquire());
+        EXPECT_FALSE(sem.try_acquire_for(std::chrono::milliseconds{5}));
+        {
+            // the caller's own deadline is not a timeout
+            deadline dl{std::chrono::milliseconds{5}};
+            EXPECT_THROW(sem.try_acquire_for(std::chrono::milliseconds{1000}), deadline_reached);
+        }
+        auto t = task::spawn([&] {
+            this_task::sleep_for(std::chrono::milliseconds{5});
+            sem.release();
+        });
+        EXPECT_TRUE(sem.try_acquire_for(std::chrono::milliseconds{1000}));
+        t.join();
+    });
+}
+
+TEST(Latch, WaitersWakeAtZero) {
+    task::main([] {
+        latch l{3};
+        int woke = 0;
+        std::vector<task> waiters;
+        for (int i=0; i<2; ++i) {
+            waiters.emplace_back(task::spawn([&] {
+                l.wait();
+                ++woke;
+            }));
+        }
+        this_task::yield();
+        l.count_down(2);
+        this_task::yield();
+        EXPECT_EQ(0, woke);
+        EXPECT_FALSE(l.try_wait());
+        l.arrive_and_wait();
+        for (auto &t : waiters) t.join();
+        EXPECT_EQ(2, woke);
+        EXPECT_TRUE(l.try_wait());
+    });
+}
+
+TEST(WaitGroup, FanIn) {
+    task::main([] {
+        wait_group wg;
+        std::atomic<int> finished{0};
+        std::vector<std::thread> threads;
+        for (int i=0; i<4; ++i) {
+            wg.add();
+            threads.emplace_back([&] {
+                task::main([&] {
+                    this_task::sleep_for(std::chrono::milliseconds{1});
+                    ++finished;
+                    wg.done();
+                });
+            });
+        }
+        for (int i=0; i<10; ++i) {
+            wg.add();
+            task::spawn([&] {
+                this_task::yield();
+                ++finished;
+                wg.done();
+            });
+        }
+        wg.wait();
+        EXPECT_EQ(14, finished.load());
+        for (auto &t : threads) t.join();
+    });
+}
@@ -464,3 +464,354 @@ TEST(Task, Join) {
     });
 }
 
+
+static size_t touch_stack(size_t bytes) {
+    // recurse in 1k frames, volatile so the compiler keeps each buffer
+    // on the stack and buf used after the call stops tail calls
+    volatile char buf[1024];
+    buf[0] = 1;
+    size_t n = bytes;
+    if (bytes > sizeof(buf)) {
+        n = touch_stack(bytes - sizeof(buf)) + sizeof(buf);
+    }
+    return n + buf[0] - 1;
+}
+
+TEST(Task, StackSize) {
+    task::main([]{
+        size_t small = 0, large = 0, odd = 0;
+        auto a = task::spawn([&]{ small = touch_stack(8 * 1024); }, 16 * 1024);
+        auto b = task::spawn([&]{ large = touch_stack(4 * 1024 * 1024); }, 8 * 1024 * 1024);
+        // not a size class, rounded up
+        auto c = task::spawn([&]{ odd = touch_stack(32 * 1024); }, 40 * 1024);
+        a.join();
+        b.join();
+        c.join();
+        EXPECT_EQ(8u * 1024, small);
+        EXPECT_EQ(4u * 1024 * 1024, large);
+        EXPECT_EQ(32u * 1024, odd);
+    });
+}
+
+TEST(Task, Recycle) {
+    task::main([]{
+        // leaves state behind that a reused task must not see
+        auto a = task::spawn([]{
+            this_task::set_priority(task_priority::background);
+            taskname("dirty");
+            taskstate("dirty");
+            this_task::sleep_for(milliseconds{1});
+        });
+        const uint64_t a_id = a.get_id();
+        a.join();
+        a = task{};
+        // let the scheduler drop its reference
+        this_task::yield();
+        for (int i=0; i<10; ++i) {
+            bool ok = false;
+            auto b = task::spawn([&]{
+                ok = this_task::get_priority() == task_priority::normal
+                    && this_task::get_id() != a_id
+                    && strcmp(taskname(), ("task[" + std::to_string(this_task::get_id()) + "]").c_str()) == 0
+                    && strcmp(taskstate(), "new") == 0;
+            });
+            b.join();
+            EXPECT_TRUE(ok);
+        }
+        // canceled before it ran
+        auto c = task::spawn([]{});
+        c.cancel();
+        c.join();
+    });
+}
+
+TEST(Task, RecycleAfterCustomStack) {
+    task::main([]{
+        // each probe records where its frame sits, so a task
+        // running on a recycled stack reports the same address
+        auto probe = [](uintptr_t &where) {
+            return [&where]{
+                volatile char c = 0;
+                where = reinterpret_cast<uintptr_t>(&c);
+            };
+        };
+        uintptr_t a_at = 0, b_at = 0, c_at = 0;
+        auto a = task::spawn(probe(a_at));
+        auto b = task::spawn(probe(b_at));
+        a.join();
+        b.join();
+        // let the scheduler drop its references
+        this_task::yield();
+        a = task{};
+        b = task{};
+        EXPECT_NE(a_at, b_at);
+        // a non-default size must leave the recycled tasks alone
+        task::spawn([]{}, 64 * 1024).join();
+        this_task::yield();
+        task::spawn(probe(c_at)).join();
+        // b was recycled last, so it is reused first
+        EXPECT_EQ(b_at, c_at);
+    });
+}
+
+TEST(Task, StackReclaim) {
+    task::main([]{
+        kernel::set_stack_reclaim(16 * 1024, 1);
+        const auto before = kernel::thread_stack_stats();
+        {
+            auto t = task::spawn([]{ touch_stack(128 * 1024); }, 256 * 1024);
+            t.join();
+        }
+        // let the scheduler drop its reference
+        this_task::yield();
+        const auto after = kernel::thread_stack_stats();
+        EXPECT_EQ(before.released + 1, after.released);
+        EXPECT_EQ(before.sampled + 1, after.sampled);
+        // touched at least 128k, so at least 112k was released
+        EXPECT_LE(before.reclaimed + 112 * 1024, after.reclaimed);
+        // 128k < high-water <= 256k
+        EXPECT_EQ(before.highwater[6] + 1, after.highwater[6]);
+        kernel::set_stack_reclaim(64 * 1024, 32);
+    });
+}
+
+TEST(Task, RecycleTrimmedToOnePage) {
+    task::main([]{
+        // the smallest keep, the recycled task itself is on that page
+        kernel::set_stack_reclaim(4096, 1);
+        for (int i=0; i<4; ++i) {
+            int ran = 0;
+            auto t = task::spawn([&]{
+                touch_stack(64 * 1024);
+                ++ran;
+            });
+            t.join();
+            EXPECT_EQ(1, ran);
+        }
+        kernel::set_stack_reclaim(64 * 1024, 32);
+    });
+}
+
+TEST(Task, StackTrimIdle) {
+    task::main([]{
+        // only the idle sweep trims
+        kernel::set_stack_reclaim(64 * 1024, 100000);
+        const auto before = kernel::thread_stack_stats();
+        {
+            // a burst leaves 100 deep stacks behind
+            std::vector<task> burst;
+            for (int i=0; i<100; ++i) {
+                burst.emplace_back(task::spawn([]{
+                    touch_stack(128 * 1024);
+                    this_task::yield();
+                }));
+            }
+            for (auto &t : burst) {
+                t.join();
+            }
+        }
+        // steady spawning reuses the top one, the rest sit idle
+        for (int i=0; i<600; ++i) {
+            task::spawn([]{}).join();
+        }
+        const auto after = kernel::thread_stack_stats();
+        EXPECT_LE(before.trimmed + 90, after.trimmed);
+        EXPECT_EQ(before.sampled, after.sampled);
+        kernel::set_stack_reclaim(64 * 1024, 32);
+    });
+}
+
+TEST(Task, SleepMicroseconds) {
+    task::main([]{
+        // make sure the scheduler waits in epoll with the timerfd
+        pipe_fd p{O_NONBLOCK};
+        auto reader = task::spawn([&] { fdwait(p.r.fd, 'r'); });
+        this_task::yield();
+        auto start = steady_clock::now();
+        for (int i=0; i<20; ++i) {
+            this_task::sleep_for(microseconds{200});
+        }
+        auto elapsed = steady_clock::now() - start;
+        EXPECT_GE(elapsed, microseconds{20 * 200});
+        // rounding each sleep up to a whole millisecond would take 20ms
+        EXPECT_LT(elapsed, milliseconds{15});
+        reader.cancel();
+    });
+}
+
+TEST(Task, Priority) {
+    task::main([]{
+        std::vector<int> order;
+        EXPECT_EQ(task_priority::normal, this_task::get_priority());
+        auto bg = task::spawn([&]{
+            this_task::set_priority(task_priority::background);
+            this_task::yield();
+            order.push_back(3);
+        });
+        auto normal = task::spawn([&]{
+            this_task::yield();
+            order.push_back(2);
+        });
+        auto crit = task::spawn([&]{
+            this_task::set_priority(task_priority::critical);
+            this_task::yield();
+            order.push_back(1);
+        });
+        bg.join();
+        normal.join();
+        crit.join();
+        EXPECT_EQ((std::vector<int>{1, 2, 3}), order);
+    });
+}
+
+TEST(Task, PriorityNoStarvation) {
+    task::main([]{
+        bool done = false;
+        int bg_runs = 0;
+        auto bg = task::spawn([&]{
+            this_task::set_priority(task_priority::background);
+            while (!done) {
+                ++bg_runs;
+                this_task::yield();
+            }
+        });
+        auto crit = task::spawn([&]{
+            this_task::set_priority(task_priority::critical);
+            for (int i=0; i<1000; ++i) {
+                this_task::yield();
+            }
+            done = true;
+        });
+        crit.join();
+        bg.join();
+        EXPECT_GT(bg_runs, 10);
+        EXPECT_LT(0u, kernel::thread_ready_stats().starved[2]);
+    });
+}
+
+TEST(Task, EarliestDeadlineFirst) {
+    task::main([]{
+        kernel::set_deadline_scheduling(true);
+        std::vector<int> order;
+        auto late = task::spawn([&]{
+            deadline dl{milliseconds{1000}};
+            this_task::yield();
+            order.push_back(2);
+        });
+        auto early = task::spawn([&]{
+            deadline dl{milliseconds{100}};
+            this_task::yield();
+            order.push_back(1);
+        });
+        auto none = task::spawn([&]{
+            this_task::yield();
+            order.push_back(3);
+        });
+        late.join();
+        early.join();
+        none.join();
+        EXPECT_EQ((std::vector<int>{1, 2, 3}), order);
+        kernel::set_deadline_scheduling(false);
+    });
+}
+
+TEST(Task, EarliestDeadlineFirstFifoNotStarved) {
+    task::main([]{
+        kernel::set_deadline_scheduling(true);
+        bool done = false;
+        unsigned spins = 0;
+        std::vector<task> busy;
+        for (int i=0; i<2; ++i) {
+            busy.emplace_back(task::spawn([&]{
+                deadline dl{milliseconds{1000}};
+                while (!done) {
+                    ++spins;
+                    this_task::yield();
+                }
+            }));
+        }
+        // no deadline, queued behind tasks that always have one
+        auto plain = task::spawn([&]{
+            this_task::yield();
+            done = true;
+        });
+        plain.join();
+        for (auto &t : busy) {
+            t.join();
+        }
+        EXPECT_LT(spins, 200u);
+        kernel::set_deadline_scheduling(false);
+    });
+}
+
+TEST(Task, RunTimeAccounting) {
+    task::main([]{
+        const auto before = kernel::thread_ready_stats();
+        auto t = task::spawn([]{
+            auto end = steady_clock::now() + milliseconds{5};
+            while (steady_clock::now() < end) {}
+            this_task::yield();
+        });
+        t.join();
+        const auto after = kernel::thread_ready_stats();
+        EXPECT_LE(milliseconds{5}, after.run_time - before.run_time);
+        uint64_t waits_before = 0, waits_after = 0;
+        for (size_t i=0; i<kernel::ready_stats::nwait; ++i) {
+            waits_before += before.wait[i];
+            waits_after += after.wait[i];
+        }
+        // spawned, yielded, and main woken by the join
+        EXPECT_LE(waits_before + 3, waits_after);
+
+        // a new thread's run time starts with its scheduler
+        const auto started = steady_clock::now();
+        kernel::duration thread_run_time{};
+        std::thread th = task::spawn_thread([&]{
+            task::spawn([]{}).join();
+            thread_run_time = kernel::thread_ready_stats().run_time;
+        });
+        th.join();
+        EXPECT_LE(thread_run_time, steady_clock::now() - started);
+    });
+}
+
+TEST(Task, EdgeTriggeredFdwait) {
+    task::main([]{
+        auto sp = socket_fd::pair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK);
+        socket_fd &r = sp.first;
+        socket_fd &w = sp.second;
+        fdregister(r.fd);
+        const auto before = kernel::thread_io_stats();
+        auto reader = task::spawn([&] {
+            char c;
+            for (int i=0; i<100; ++i) {
+                while (r.recv(&c, 1) != 1) {
+                    ASSERT_TRUE(io_not_ready());
+                    ASSERT_TRUE(fdwait(r.fd, 'r'));
+                }
+                EXPECT_EQ(char(i), c);
+            }
+        });
+        for (int i=0; i<100; ++i) {
+            char c = i;
+            EXPECT_EQ(1, w.send(&c, 1));
+            this_task::yield();
+        }
+        reader.join();
+        auto after = kernel::thread_io_stats();
+        // registered once, no epoll_ctl per wait
+        EXPECT_EQ(before.ctl, after.ctl);
+        EXPECT_LT(before.wait, after.wait);
+
+        // an edge that came while nobody waited is kept for the next wait
+        char c = 'x';
+        EXPECT_EQ(1, w.send(&c, 1));
+        this_task::sleep_for(milliseconds{1});
+        EXPECT_TRUE(fdwait(r.fd, 'r'));
+        EXPECT_EQ(after.edge_ready + 1, kernel::thread_io_stats().edge_ready);
+        EXPECT_EQ(1, r.recv(&c, 1));
+        // and taken by it
+        EXPECT_FALSE(fdwait(r.fd, 'r', milliseconds{5}));
+        fdunregister(r.fd);
+    });
+}
@@ -0,0 +1,93 @@
+#include "gtest/gtest.h"
+#include "ten/task.hh"
+#include "ten/task/trace.hh"
+#include "ten/channel.hh"
+#include <sstream>
+#include <atomic>
+#include <thread>
+
+using namespace ten;
+
+static size_t count(const std::string &s, const std::string &what) {
+    size_t n = 0;
+    for (size_t pos = s.find(what); pos != std::string::npos; pos = s.find(what, pos + 1)) {
+        ++n;
+    }
+    return n;
+}
+
+TEST(Trace, SwapAndSpawn) {
+    task::main([] {
+        trace::clear();
+        trace::enable(1024);
+        auto t = task::spawn([] {
+            this_task::yield();
+        });
+        const std::string name = "\"task " + std::to_string(t.get_id()) + "\"";
+        t.join();
+        trace::disable();
+        std::ostringstream ss;
+        trace::dump_chrome_json(ss);
+        const std::string json = ss.str();
+        EXPECT_EQ(0u, json.find("{\"traceEvents\":["));
+        // ran twice, around the yield: two begin/end pairs
+        EXPECT_LE(4u, count(json, name));
+        EXPECT_EQ(count(json, "\"ph\":\"B\""), count(json, "\"ph\":\"E\"") + 1); // main is still running
+        EXPECT_NE(std::string::npos, json.find("\"name\":\"spawn\""));
+        EXPECT_NE(std::string::npos, json.find("\"name\":\"exit\""));
+    });
+}
+
+TEST(Trace, CrossThreadWakeup) {
+    task::main([] {
+        trace::clear();
+        trace::enable(1024);
+        channel<int> ch;
+        std::thread th = task::spawn_thread([=]() mutable {
+            ch.send(42);
+        });
+        EXPECT_EQ(42, ch.recv());
+        th.join();
+        trace::disable();
+        std::ostringstream ss;
+        trace::dump_chrome_json(ss);
+        const std::string json = ss.str();
+        // flow arrow from the sending thread to the receiver
+        EXPECT_LE(1u, count(json, "\"ph\":\"s\""));
+        EXPECT_EQ(count(json, "\"ph\":\"s\""), count(json, "\"ph\":\"f\""));
+    });
+}
+
+TEST(Trace, DumpWhileWriting) {
+    task::main([] {
+        trace::clear();
+        // small rings, so the writer laps them while we copy
+        trace::enable(16);
+        std::atomic<bool> done{false};
+        std::thread th = task::spawn_thread([&] {
+            while (!done) {
+                task::spawn([] {}).join();
+            }
+        });
+        for (int i=0; i<200; ++i) {
+            std::ostringstream ss;
+            trace::dump_chrome_json(ss);
+            // a torn copy shows up as a bad event type
+            EXPECT_EQ(std::string::npos, ss.str().find("\"name\":\"unknown\""));
+        }
+        done = true;
+        th.join();
+        trace::disable();
+    });
+}
+
+TEST(Trace, Disabled) {
+    task::main([] {
+        trace::clear();
+        EXPECT_FALSE(trace::enabled());
+        task::spawn([] {}).join();
+        std::ostringstream ss;
+        trace::dump_chrome_json(ss);
+        EXPECT_EQ(std::string::npos, ss.str().find("\"ph\""));
+    });
+}
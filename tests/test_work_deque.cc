@@ -63,3 +63,21 @@ TEST(WorkDeque, Test) {
 
     ASSERT_EQ(work_units, completed.load());
 }
+
+TEST(WorkDeque, TakeEmpty) {
+    work_deque<int> q{4};
+    EXPECT_TRUE(q.empty());
+    EXPECT_FALSE(q.take());
+    // grow a few times
+    for (int i=0; i<100; ++i) {
+        q.push(i);
+    }
+    EXPECT_FALSE(q.empty());
+    for (int i=99; i>=0; --i) {
+        optional<int> x = q.take();
+        ASSERT_TRUE((bool)x);
+        EXPECT_EQ(i, *x);
+    }
+    EXPECT_TRUE(q.empty());
+    EXPECT_FALSE(q.take());
+}